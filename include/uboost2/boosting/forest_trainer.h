@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include <uboost2/data.h>
+#include <uboost2/parallel.h>
+#include <uboost2/tree/tree.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/tree/ensemble.h>
+#include <uboost2/tree/builder/builder_layerwise.h>
+
+// random forest: the dataset is sorted once and shared by all the trees, each tree gets its own row
+// weights (bootstrap counts, or 0/1 for a subsample without replacement) and its own columns
+// trees are built concurrently, one per thread; tree t only draws from the stream seeded with
+// (seed, t), so the forest does not depend on the number of threads
+template <typename X = double>
+class ForestTrainer {
+	Dataset<X> data;
+	std::vector<Tree> trees;
+	Ensemble ensemble;
+	size_t n_estimators = 100;
+	double subsample = 1.0;
+	bool bootstrap = true;
+	//
+	size_t max_depth = 10;
+	size_t min_samples_leaf = 1, min_samples_split = 2;
+	double min_weight_leaf = 0.0, min_weight_split = 0.0;
+	double colsample_bytree = 1.0, colsample_bylevel = 1.0;
+	unsigned seed = 0;
+	int n_threads = 1;
+protected:
+	// round(subsample * n) rows, drawn with replacement (the weight is the count) or without
+	DColumn<> draw_weights(std::mt19937& generator) const {
+		const size_t nrows = data.nrows();
+		const size_t n = std::max<size_t>(1, (size_t)std::llround(subsample * nrows));
+		DColumn<> w(nrows, 0.0);
+		if (bootstrap) {
+			std::uniform_int_distribution<size_t> row(0, nrows - 1);
+			for (size_t k = 0; k < n; k++) w(row(generator)) += 1.0;
+		}
+		else {
+			// partial Fisher-Yates: the first n entries end up a uniform sample
+			std::vector<uint32_t> rows(nrows);
+			std::iota(rows.begin(), rows.end(), 0);
+			for (size_t k = 0; k < std::min(n, nrows); k++) {
+				std::uniform_int_distribution<size_t> pick(k, nrows - 1);
+				std::swap(rows[k], rows[pick(generator)]);
+				w(rows[k]) = 1.0;
+			}
+		}
+		return w;
+	}
+	void fit_tree(size_t t) {
+		std::seed_seq sequence{ seed, (unsigned)t };
+		std::mt19937 generator(sequence);
+		const DColumn<> w = draw_weights(generator);
+		LayerWiseTreeBuilder<X>(data.with_w(w), min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+			colsample_bytree, colsample_bylevel, 0.0, (unsigned)generator(), 1).update(trees[t]);
+	}
+public:
+	ForestTrainer(const DMatrix<X>& x, const DColumn<>& y,
+		size_t n_estimators = 100, double subsample = 1.0, bool bootstrap = true,
+		size_t max_depth = 10, size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		unsigned seed = 0, int n_threads = 1) :
+		data{ x, n_threads } {
+		assert(y.nrows() == x.nrows());
+		assert(subsample > 0.0);
+		this->n_estimators = n_estimators;
+		this->subsample = subsample;
+		this->bootstrap = bootstrap;
+		this->max_depth = max_depth;
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_samples_split = min_samples_split;
+		this->min_weight_leaf = min_weight_leaf;
+		this->min_weight_split = min_weight_split;
+		this->colsample_bytree = colsample_bytree;
+		this->colsample_bylevel = colsample_bylevel;
+		this->seed = seed;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
+		data.set_y(y);
+	}
+	// the trees average: the ensemble sums their values scaled by 1 / n_estimators
+	const Ensemble& train() {
+		// sorted once, before the trees share it
+		data.get_index();
+		trees.assign(n_estimators, Tree(max_depth));
+		#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+		for (int t = 0; t < (int)n_estimators; t++) fit_tree(t);
+
+		ensemble = Ensemble();
+		const double scale = 1.0 / n_estimators;
+		for (Tree tree : trees) {
+			for (size_t nid = 0; nid <= trees::max_idx_at_depth(max_depth); nid++) tree[nid].value *= scale;
+			ensemble.add(tree);
+		}
+		return ensemble;
+	}
+	//
+	const Ensemble& get_ensemble() const {
+		return ensemble;
+	}
+	const Tree& get_tree(size_t t) const {
+		return trees[t];
+	}
+	size_t size() const {
+		return trees.size();
+	}
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#include <uboost2/data.h>
+#include <uboost2/losses.h>
+#include <uboost2/parallel.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/tree/compiled_tree.h>
+#include <uboost2/tree/ensemble.h>
+#include <uboost2/tree/builder/builder_layerwise_gh.h>
+#include <uboost2/tree/builder/builder_layerwise_hist_gh.h>
+
+// the whole boosting loop in one place: the dataset is sorted/quantized once, every round computes
+// the gradients of the loss on the running predictions, fits a GH tree to the scaled step and
+// adds its (clipped) values to the predictions
+template <typename X = double>
+class GBMTrainer {
+	Dataset<X> data;
+	DColumn<> p;
+	std::unique_ptr<Loss> loss;
+	Ensemble ensemble;
+	size_t n_estimators = 100;
+	double learning_rate = 0.1, max_delta_step = INFINITY;
+	size_t iteration = 0;
+	//
+	size_t max_depth = 6;
+	size_t min_samples_leaf = 1, min_samples_split = 2;
+	double min_weight_leaf = 0.0, min_weight_split = 0.0;
+	double colsample_bytree = 1.0, colsample_bylevel = 1.0;
+	double reg_lambda = 1.0, reg_alpha = 0.0;
+	std::string tree_method = "exact";
+	size_t max_bins = MAX_BINS;
+	int n_threads = 1;
+protected:
+	void fit_round() {
+		data.update_gradients(*loss, p, -learning_rate);
+
+		Tree tree(max_depth);
+		if (tree_method == "exact") {
+			GHLayerWiseTreeBuilder<X>(data, min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+				colsample_bytree, colsample_bylevel, reg_lambda, reg_alpha, 1.0, 0.0, (unsigned)iteration, n_threads).update(tree);
+		}
+		else {
+			GHHistLayerWiseTreeBuilder<X>(data, min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+				colsample_bytree, colsample_bylevel, reg_lambda, reg_alpha, max_bins, 1.0, 0.0, (unsigned)iteration, n_threads).update(tree);
+		}
+
+		CompiledTree compiled(tree);
+		const DMatrix<X>& x = data.get_x();
+		double* pp = p.data();
+		#pragma omp parallel for num_threads(n_threads)
+		for (int i = 0; i < (int)x.nrows(); i++) {
+			pp[i] += std::clamp(compiled.predict_value_row(x, i), -max_delta_step, max_delta_step);
+		}
+		ensemble.add(compiled);
+	}
+public:
+	// called with the round just fitted and the training loss, returning true stops the training
+	using Callback = std::function<bool(size_t, double)>;
+
+	GBMTrainer(const DMatrix<X>& x, const DColumn<>& y, const std::string& loss = "mse",
+		size_t n_estimators = 100, double learning_rate = 0.1, double max_delta_step = INFINITY,
+		size_t max_depth = 6, size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0,
+		const std::string& tree_method = "exact", size_t max_bins = MAX_BINS, int n_threads = 1) :
+		data{ x, n_threads }, p{ x.nrows(), 0.0 }, loss{ losses::get(loss) } {
+		assert(y.nrows() == x.nrows());
+		if (tree_method != "exact" && tree_method != "hist") throw std::invalid_argument("Tree method " + tree_method + " not found");
+		this->n_estimators = n_estimators;
+		this->learning_rate = learning_rate;
+		this->max_delta_step = max_delta_step;
+		this->max_depth = max_depth;
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_samples_split = min_samples_split;
+		this->min_weight_leaf = min_weight_leaf;
+		this->min_weight_split = min_weight_split;
+		this->colsample_bytree = colsample_bytree;
+		this->colsample_bylevel = colsample_bylevel;
+		this->reg_lambda = reg_lambda;
+		this->reg_alpha = reg_alpha;
+		this->tree_method = tree_method;
+		this->max_bins = max_bins;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
+		data.set_y(y);
+
+		const double base_score = this->loss->base_score(y);
+		for (size_t i = 0; i < p.nrows(); i++) p(i) = base_score;
+		ensemble = Ensemble(base_score, max_delta_step);
+	}
+	// runs the remaining rounds, the callback (if any) every callback_every rounds
+	const Ensemble& train(const Callback& callback = nullptr, size_t callback_every = 1) {
+		while (iteration < n_estimators) {
+			fit_round();
+			iteration++;
+			if (callback && callback_every > 0 && iteration % callback_every == 0) {
+				if (callback(iteration - 1, loss->value(data.get_y(), p))) break;
+			}
+		}
+		return ensemble;
+	}
+	//
+	const Ensemble& get_ensemble() const {
+		return ensemble;
+	}
+	const DColumn<>& get_predictions() const {
+		return p;
+	}
+	size_t get_iteration() const {
+		return iteration;
+	}
+	double get_loss() const {
+		return loss->value(data.get_y(), p);
+	}
+};
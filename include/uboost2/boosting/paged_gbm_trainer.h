@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+#include <uboost2/data.h>
+#include <uboost2/losses.h>
+#include <uboost2/parallel.h>
+#include <uboost2/tree/paged_dataset.h>
+#include <uboost2/tree/compiled_tree.h>
+#include <uboost2/tree/ensemble.h>
+#include <uboost2/tree/builder/builder_layerwise_paged_gh.h>
+
+// GBMTrainer (hist) out of core: the features stay on disk as a paged file, a round reads it once per
+// level to build the tree and once more to add the tree to the predictions; in memory only the
+// targets, predictions and gradients (4 doubles per row), the page buffers and the histograms
+// the trees split on the cuts of the file, they score raw features like any other ensemble
+class PagedGBMTrainer {
+	PagedDataset data;
+	DColumn<> y, p, g, h, w;
+	std::unique_ptr<Loss> loss;
+	Ensemble ensemble;
+	size_t n_estimators = 100;
+	double learning_rate = 0.1, max_delta_step = INFINITY;
+	size_t iteration = 0;
+	//
+	size_t max_depth = 6;
+	size_t min_samples_leaf = 1, min_samples_split = 2;
+	double min_weight_leaf = 0.0, min_weight_split = 0.0;
+	double colsample_bytree = 1.0, colsample_bylevel = 1.0;
+	double reg_lambda = 1.0, reg_alpha = 0.0;
+	size_t n_buffers = 2;
+	int n_threads = 1;
+protected:
+	// the values of the tree at the rows, descending on the bin codes of the pages
+	void add_to_predictions(const Tree& tree) {
+		std::vector<size_t> split_bins(trees::max_idx_at_depth(tree.get_max_depth()) + 1, 0);
+		for (size_t nid = 0; nid < split_bins.size(); nid++) {
+			if (!tree[nid].is_leaf) split_bins[nid] = data.get_split_bin(tree[nid].column, tree[nid].threshold);
+		}
+		PageStream stream(data, n_buffers);
+		PageStream::Page page;
+		while (stream.next(page)) {
+			#pragma omp parallel for num_threads(n_threads)
+			for (int r = 0; r < (int)page.nrows; r++) {
+				size_t nid = trees::ROOTID;
+				while (!tree[nid].is_leaf) {
+					const size_t code = page.column(tree[nid].column)[r];
+					const bool right = code == data.get_missing_bin(tree[nid].column) ? !tree[nid].default_left : code >= split_bins[nid];
+					nid = right ? trees::right_child(nid) : trees::left_child(nid);
+				}
+				p(page.first_row + r) += std::clamp(tree[nid].value, -max_delta_step, max_delta_step);
+			}
+		}
+	}
+	void fit_round() {
+		loss->grad_and_hess(y, p, g, h, -learning_rate, n_threads);
+
+		Tree tree(max_depth);
+		GHPagedLayerWiseTreeBuilder(data, g, h, w, min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+			colsample_bytree, colsample_bylevel, reg_lambda, reg_alpha, (unsigned)iteration, n_buffers, n_threads).update(tree);
+
+		add_to_predictions(tree);
+		ensemble.add(CompiledTree(tree));
+	}
+public:
+	// called with the round just fitted and the training loss, returning true stops the training
+	using Callback = std::function<bool(size_t, double)>;
+
+	PagedGBMTrainer(const PagedDataset& data, const DColumn<>& y, const std::string& loss = "mse",
+		size_t n_estimators = 100, double learning_rate = 0.1, double max_delta_step = INFINITY,
+		size_t max_depth = 6, size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0, size_t n_buffers = 2, int n_threads = 1) :
+		data{ data }, y{ data.nrows() }, p{ data.nrows(), 0.0 }, g{ data.nrows(), 0.0 }, h{ data.nrows(), 1.0 },
+		w{ data.nrows(), 1.0 }, loss{ losses::get(loss) } {
+		if (y.nrows() != data.nrows()) throw std::runtime_error("Paged dataset and targets have different numbers of rows");
+		this->n_estimators = n_estimators;
+		this->learning_rate = learning_rate;
+		this->max_delta_step = max_delta_step;
+		this->max_depth = max_depth;
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_samples_split = min_samples_split;
+		this->min_weight_leaf = min_weight_leaf;
+		this->min_weight_split = min_weight_split;
+		this->colsample_bytree = colsample_bytree;
+		this->colsample_bylevel = colsample_bylevel;
+		this->reg_lambda = reg_lambda;
+		this->reg_alpha = reg_alpha;
+		this->n_buffers = n_buffers;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
+		std::copy(y.data(), y.data() + y.nrows(), this->y.data());
+
+		const double base_score = this->loss->base_score(y);
+		for (size_t i = 0; i < p.nrows(); i++) p(i) = base_score;
+		ensemble = Ensemble(base_score, max_delta_step);
+	}
+	// runs the remaining rounds, the callback (if any) every callback_every rounds
+	const Ensemble& train(const Callback& callback = nullptr, size_t callback_every = 1) {
+		while (iteration < n_estimators) {
+			fit_round();
+			iteration++;
+			if (callback && callback_every > 0 && iteration % callback_every == 0) {
+				if (callback(iteration - 1, loss->value(this->y, p))) break;
+			}
+		}
+		return ensemble;
+	}
+	//
+	const Ensemble& get_ensemble() const {
+		return ensemble;
+	}
+	const DColumn<>& get_predictions() const {
+		return p;
+	}
+	size_t get_iteration() const {
+		return iteration;
+	}
+	double get_loss() const {
+		return loss->value(y, p);
+	}
+};
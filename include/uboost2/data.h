@@ -1,14 +1,31 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include <algorithm>
 #include <numeric>
 #include <iterator>
 #include <iostream>
 #include <iomanip>
 #include <random>
+#include <cstdint>
+#include <cstring>
 #include <cassert>
 
+#include <uboost2/parallel.h>
+
+// missing values are NaNs; the test reads the bits because -ffast-math lets the compiler fold std::isnan to false
+inline bool is_missing(double x) {
+	uint64_t bits;
+	std::memcpy(&bits, &x, sizeof(bits));
+	return (bits & 0x7fffffffffffffffULL) > 0x7ff0000000000000ULL;
+}
+inline bool is_missing(float x) {
+	uint32_t bits;
+	std::memcpy(&bits, &x, sizeof(bits));
+	return (bits & 0x7fffffffu) > 0x7f800000u;
+}
+
 // interfaces
 
 template <typename T>
@@ -106,7 +123,9 @@ public:
 template <typename T=double>
 class DMatrix : public AbstractDMatrix<T> {
 protected:
-	std::shared_ptr<std::vector<T>> m_data;
+	// column-major storage, m_base keeps alive whoever owns it (an internal vector or a wrapped buffer)
+	std::shared_ptr<void> m_base;
+	T* m_data = nullptr;
 	size_t m_nrows, m_ncols;
 	bool m_owning = false;
 public:
@@ -122,8 +141,9 @@ public:
 		assert(ncols > 0);
 		m_nrows = nrows;
 		m_ncols = ncols;
-		m_data = std::make_shared<std::vector<T>>();
-		m_data->resize(nrows * ncols);
+		auto storage = std::make_shared<std::vector<T>>(nrows * ncols);
+		m_data = storage->data();
+		m_base = storage;
 		m_owning = true;
 	}
 	DMatrix(size_t nrows, size_t ncols, const T& t) {
@@ -131,30 +151,48 @@ public:
 		assert(ncols > 0);
 		m_nrows = nrows;
 		m_ncols = ncols;
-		m_data = std::make_shared<std::vector<T>>();
-		m_data->resize(nrows * ncols, t);
+		auto storage = std::make_shared<std::vector<T>>(nrows * ncols, t);
+		m_data = storage->data();
+		m_base = storage;
 		m_owning = true;
 	}
+	// non-owning view of a column-major buffer, base (if any) is held as long as the view lives
+	DMatrix(T* data, size_t nrows, size_t ncols, std::shared_ptr<void> base = nullptr) {
+		assert(data != nullptr);
+		m_nrows = nrows;
+		m_ncols = ncols;
+		m_data = data;
+		m_base = base;
+		m_owning = false;
+	}
 	DMatrix(const DMatrix<T>& mat) {
 		m_nrows = mat.m_nrows;
 		m_ncols = mat.m_ncols;
 		m_data = mat.m_data;
-		assert(m_data->size() > 0);
+		m_base = mat.m_base;
+		assert(m_data != nullptr);
 		m_owning = false;
 	}
 	~DMatrix() {}
 	//
 	inline T& operator()(size_t i, size_t j) override {
 #ifdef DEBUG
-		if (j * m_nrows + i >= m_data->size()) std::printf("Out of bound! (%d, %d)\n", i, j);
+		if (j * m_nrows + i >= m_nrows * m_ncols) std::printf("Out of bound! (%d, %d)\n", i, j);
 #endif // DEBUG
-		return (*m_data)[j * m_nrows + i];
+		return m_data[j * m_nrows + i];
 	}
 	inline const T& operator()(size_t i, size_t j) const override {
 #ifdef DEBUG
-		if (j * m_nrows + i >= m_data->size()) std::printf("Out of bound! (%d, %d)\n", i, j);
+		if (j * m_nrows + i >= m_nrows * m_ncols) std::printf("Out of bound! (%d, %d)\n", i, j);
 #endif // DEBUG
-		return (*m_data)[j * m_nrows + i];
+		return m_data[j * m_nrows + i];
+	}
+	// contiguous storage of a column
+	inline T* column_data(size_t j) {
+		return m_data + j * m_nrows;
+	}
+	inline const T* column_data(size_t j) const {
+		return m_data + j * m_nrows;
 	}
 };
 
@@ -179,6 +217,12 @@ public:
 	inline const T& operator()(size_t i) const override {
 		return DMatrix<T>::operator()(i, m_column);
 	}
+	inline T* data() {
+		return DMatrix<T>::column_data(m_column);
+	}
+	inline const T* data() const {
+		return DMatrix<T>::column_data(m_column);
+	}
 	//
 	friend std::ostream& operator<<(std::ostream& os, const DColumn<T>& d) {
 		for (size_t i = 0; i < d.nrows(); i++) {
@@ -209,21 +253,19 @@ public:
 };
 
 
-//
-namespace random {
-	DMatrix<> uniform(size_t nrows, size_t ncols) {
-		std::random_device rd;
-		std::mt19937 gen(rd());
+// seeded, so the same seed gives the same data on every run (named so as not to collide with POSIX random())
+namespace randoms {
+	inline DMatrix<> uniform(size_t nrows, size_t ncols, unsigned seed = std::random_device{}()) {
+		std::mt19937 gen(seed);
 		std::uniform_real_distribution<> dis(0.0, 1.0);
 		DMatrix<> m(nrows, ncols);
-		for (size_t i = 0; i < nrows; i++) for (size_t j = 0; j < ncols; j++) {
+		for (size_t j = 0; j < ncols; j++) for (size_t i = 0; i < nrows; i++) {
 			m(i, j) = dis(gen);
 		}
 		return m;
 	}
-	DColumn<> uniform(size_t nrows) {
-		std::random_device rd;
-		std::mt19937 gen(rd());
+	inline DColumn<> uniform(size_t nrows, unsigned seed = std::random_device{}()) {
+		std::mt19937 gen(seed);
 		std::uniform_real_distribution<> dis(0.0, 1.0);
 		DColumn<> m(nrows);
 		for (size_t i = 0; i < nrows; i++) {
@@ -232,9 +274,8 @@ namespace random {
 		return m;
 	}
 	//
-	DColumn<> normal(size_t nrows) {
-		std::random_device rd;
-		std::mt19937 gen(rd());
+	inline DColumn<> normal(size_t nrows, unsigned seed = std::random_device{}()) {
+		std::mt19937 gen(seed);
 		std::normal_distribution<> dis(0.0, 1.0);
 		DColumn<> m(nrows);
 		for (size_t i = 0; i < nrows; i++) {
@@ -260,4 +301,25 @@ namespace matrix {
 		}
 		return m;
 	}
+	// column-major copy of a strided buffer (strides in elements)
+	// walked in square blocks, so a row-major source is read and written within cache
+	template <typename T>
+	DMatrix<T> from_strided(const T* src, size_t nrows, size_t ncols, ptrdiff_t row_stride, ptrdiff_t col_stride, int n_threads = 1) {
+		constexpr size_t BLOCK = 64;
+		DMatrix<T> m(nrows, ncols);
+		n_threads = parallel::resolve_n_threads(n_threads);
+		const size_t row_blocks = (nrows + BLOCK - 1) / BLOCK;
+		#pragma omp parallel for num_threads(n_threads) schedule(static)
+		for (int rb = 0; rb < (int)row_blocks; rb++) {
+			const size_t i0 = rb * BLOCK, i1 = std::min(i0 + BLOCK, nrows);
+			for (size_t j0 = 0; j0 < ncols; j0 += BLOCK) {
+				const size_t j1 = std::min(j0 + BLOCK, ncols);
+				for (size_t j = j0; j < j1; j++) {
+					T* dst = m.column_data(j);
+					for (size_t i = i0; i < i1; i++) dst[i] = src[i * row_stride + j * col_stride];
+				}
+			}
+		}
+		return m;
+	}
 };
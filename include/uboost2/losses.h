@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cassert>
+
+#include <uboost2/data.h>
+
+// losses on raw scores p: value, per-row gradient/hessian and the constant score to start from
+// the gradient kernels are fused: one pass over the rows writes scale * gradient and the hessian
+// straight into g and h, the loops are plain enough for the compiler to vectorize (exp included,
+// with -ffast-math -fopenmp)
+class Loss {
+public:
+	virtual ~Loss() {}
+	virtual double value(const DColumn<>& y, const DColumn<>& p) const = 0;
+	virtual void grad(const DColumn<>& y, const DColumn<>& p, DColumn<>& g, double scale = 1.0, int n_threads = 1) const = 0;
+	virtual void grad_and_hess(const DColumn<>& y, const DColumn<>& p, DColumn<>& g, DColumn<>& h,
+		double scale = 1.0, int n_threads = 1) const = 0;
+	virtual double base_score(const DColumn<>& y) const = 0;
+};
+
+class MSELoss : public Loss {
+public:
+	double value(const DColumn<>& y, const DColumn<>& p) const override {
+		assert(y.nrows() == p.nrows());
+		const double* yp = y.data();
+		const double* pp = p.data();
+		double tot = 0.0;
+		#pragma omp simd reduction(+:tot)
+		for (size_t i = 0; i < y.nrows(); i++) tot += (yp[i] - pp[i]) * (yp[i] - pp[i]);
+		return tot / y.nrows();
+	}
+	void grad(const DColumn<>& y, const DColumn<>& p, DColumn<>& g, double scale = 1.0, int n_threads = 1) const override {
+		assert(y.nrows() == p.nrows() && g.nrows() == p.nrows());
+		const double* yp = y.data();
+		const double* pp = p.data();
+		double* gp = g.data();
+		#pragma omp parallel for simd num_threads(n_threads)
+		for (int i = 0; i < (int)y.nrows(); i++) gp[i] = scale * (pp[i] - yp[i]);
+	}
+	// the hessian is 1 rather than 2, as in xgboost and losses.py
+	void grad_and_hess(const DColumn<>& y, const DColumn<>& p, DColumn<>& g, DColumn<>& h,
+		double scale = 1.0, int n_threads = 1) const override {
+		assert(y.nrows() == p.nrows() && g.nrows() == p.nrows() && h.nrows() == p.nrows());
+		const double* yp = y.data();
+		const double* pp = p.data();
+		double* gp = g.data();
+		double* hp = h.data();
+		#pragma omp parallel for simd num_threads(n_threads)
+		for (int i = 0; i < (int)y.nrows(); i++) {
+			gp[i] = scale * (pp[i] - yp[i]);
+			hp[i] = 1.0;
+		}
+	}
+	double base_score(const DColumn<>& y) const override {
+		return y.sum() / y.nrows();
+	}
+};
+
+class LogLoss : public Loss {
+protected:
+	static inline double sigmoid(double x) {
+		return 1.0 / (1.0 + std::exp(-x));
+	}
+public:
+	double value(const DColumn<>& y, const DColumn<>& p) const override {
+		assert(y.nrows() == p.nrows());
+		const double* yp = y.data();
+		const double* pp = p.data();
+		double tot = 0.0;
+		#pragma omp simd reduction(+:tot)
+		for (size_t i = 0; i < y.nrows(); i++) {
+			const double pr = std::clamp(sigmoid(pp[i]), 1e-15, 1.0 - 1e-15);
+			tot += -yp[i] * std::log(pr) - (1.0 - yp[i]) * std::log(1.0 - pr);
+		}
+		return tot / y.nrows();
+	}
+	void grad(const DColumn<>& y, const DColumn<>& p, DColumn<>& g, double scale = 1.0, int n_threads = 1) const override {
+		assert(y.nrows() == p.nrows() && g.nrows() == p.nrows());
+		const double* yp = y.data();
+		const double* pp = p.data();
+		double* gp = g.data();
+		#pragma omp parallel for simd num_threads(n_threads)
+		for (int i = 0; i < (int)y.nrows(); i++) gp[i] = scale * (sigmoid(pp[i]) - yp[i]);
+	}
+	// the sigmoid is computed once per row for both
+	void grad_and_hess(const DColumn<>& y, const DColumn<>& p, DColumn<>& g, DColumn<>& h,
+		double scale = 1.0, int n_threads = 1) const override {
+		assert(y.nrows() == p.nrows() && g.nrows() == p.nrows() && h.nrows() == p.nrows());
+		const double* yp = y.data();
+		const double* pp = p.data();
+		double* gp = g.data();
+		double* hp = h.data();
+		#pragma omp parallel for simd num_threads(n_threads)
+		for (int i = 0; i < (int)y.nrows(); i++) {
+			const double pr = sigmoid(pp[i]);
+			gp[i] = scale * (pr - yp[i]);
+			hp[i] = std::max(pr * (1.0 - pr), 1e-12);
+		}
+	}
+	double base_score(const DColumn<>& y) const override {
+		const double mean = std::clamp(y.sum() / y.nrows(), 1e-15, 1.0 - 1e-15);
+		return std::log(mean / (1.0 - mean));
+	}
+};
+
+namespace losses {
+	// same names as the python registry in losses.py
+	inline std::unique_ptr<Loss> get(std::string name) {
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+		if (name == "mse") return std::make_unique<MSELoss>();
+		if (name == "logloss") return std::make_unique<LogLoss>();
+		throw std::invalid_argument("Loss " + name + " not found");
+	}
+}
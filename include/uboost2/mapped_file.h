@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// read-only mapping of a whole file: the pages come from the OS page cache, so every process
+// mapping the same file shares them; unmapped when the object dies
+class MappedFile {
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+#endif
+public:
+	MappedFile(const std::string& path) {
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open " + path);
+		LARGE_INTEGER size;
+		GetFileSizeEx(m_file, &size);
+		m_size = (size_t)size.QuadPart;
+		if (m_size > 0) {
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping != nullptr) m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+			if (m_data == nullptr) {
+				if (m_mapping != nullptr) CloseHandle(m_mapping);
+				CloseHandle(m_file);
+				throw std::runtime_error("Cannot map " + path);
+			}
+		}
+#else
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("Cannot open " + path);
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			throw std::runtime_error("Cannot stat " + path);
+		}
+		m_size = (size_t)st.st_size;
+		if (m_size > 0) {
+			void* p = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED) {
+				close(fd);
+				throw std::runtime_error("Cannot map " + path);
+			}
+			m_data = static_cast<const char*>(p);
+		}
+		// the mapping stays valid without the descriptor
+		close(fd);
+#endif
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() {
+#ifdef _WIN32
+		if (m_data != nullptr) UnmapViewOfFile(m_data);
+		if (m_mapping != nullptr) CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+		if (m_data != nullptr) munmap(const_cast<char*>(m_data), m_size);
+#endif
+	}
+	//
+	const char* data() const {
+		return m_data;
+	}
+	size_t size() const {
+		return m_size;
+	}
+};
@@ -3,24 +3,35 @@
 #include <pybind11/numpy.h>
 
 #include <uboost2/data.h>
+#include <uboost2/sparse.h>
 
 namespace py = pybind11;
 
-DMatrix<double> numpyToDMatrix(py::array_t<double> arr) {
+// the buffer of a wrapped array must outlive the matrix: hold a reference to the array
+inline std::shared_ptr<void> keep_alive(const py::array& arr) {
+	return std::shared_ptr<void>(new py::array(arr), [](void* p) {
+		py::gil_scoped_acquire gil;
+		delete static_cast<py::array*>(p);
+	});
+}
+
+// Fortran-ordered arrays are wrapped in place, anything else goes through one blocked transpose
+// T is the precision the array already has (float32 or float64): nothing is widened on the way in
+template <typename T = double>
+DMatrix<T> numpyToDMatrix(py::array_t<T> arr, int n_threads = 1) {
 	auto r = arr.request();
 	if (r.ndim != 2) {
 		throw std::runtime_error("NDIM Must be == 2");
 	}
-	auto p = reinterpret_cast<double*>(r.ptr);
+	auto p = reinterpret_cast<T*>(r.ptr);
+	const size_t nrows = r.shape[0], ncols = r.shape[1];
+	const ptrdiff_t row_stride = r.strides[0] / (ptrdiff_t)sizeof(T);
+	const ptrdiff_t col_stride = r.strides[1] / (ptrdiff_t)sizeof(T);
 
-	DMatrix<double> data(r.shape[0], r.shape[1]);
-	for (size_t i = 0; i < r.shape[0]; i++) {
-		for (size_t j = 0; j < r.shape[1]; j++) {
-			data(i, j) = p[i * r.shape[1] + j];
-		}
+	if (row_stride == 1 && (col_stride == (ptrdiff_t)nrows || ncols == 1)) {
+		return DMatrix<T>(p, nrows, ncols, keep_alive(arr));
 	}
-
-	return data;
+	return matrix::from_strided(p, nrows, ncols, row_stride, col_stride, n_threads);
 }
 
 DColumn<double> numpyToDColumn(py::array_t<double> arr) {
@@ -29,10 +40,15 @@ DColumn<double> numpyToDColumn(py::array_t<double> arr) {
 		throw std::runtime_error("NDIM Must be == 1");
 	}
 	auto p = reinterpret_cast<double*>(r.ptr);
+	const size_t nrows = r.shape[0];
+	const ptrdiff_t stride = r.strides[0] / (ptrdiff_t)sizeof(double);
 
-	DColumn<double> data(r.shape[0]);
-	for (size_t i = 0; i < r.shape[0]; i++) {
-		data(i) = p[i];
+	if (stride == 1) {
+		return DColumn<double>(DMatrix<double>(p, nrows, 1, keep_alive(arr)), 0);
+	}
+	DColumn<double> data(nrows);
+	for (size_t i = 0; i < nrows; i++) {
+		data(i) = p[i * stride];
 	}
 
 	return data;
@@ -53,3 +69,36 @@ void DColumntoNumpyInplace(const DColumn<double> xin, py::array_t<double> xout)
 		p[i] = xin(i);
 	}
 }
+
+
+// scipy.sparse compressed arrays (indptr, indices, data) are copied: the indices become 32-bit
+template <typename Matrix>
+Matrix numpyToCompressed(py::array_t<int64_t> indptr, py::array_t<int64_t> indices, py::array_t<double> data,
+	size_t nrows, size_t ncols, size_t n_major) {
+	auto rp = indptr.unchecked<1>();
+	auto ri = indices.unchecked<1>();
+	auto rd = data.unchecked<1>();
+	if ((size_t)rp.shape(0) != n_major + 1) {
+		throw std::runtime_error("indptr must have one entry more than the compressed dimension");
+	}
+	if (ri.shape(0) != rd.shape(0) || (size_t)rp(n_major) != (size_t)rd.shape(0)) {
+		throw std::runtime_error("indices and data must have indptr[-1] entries");
+	}
+	std::vector<size_t> indptr_(n_major + 1);
+	std::vector<uint32_t> indices_(ri.shape(0));
+	std::vector<double> data_(rd.shape(0));
+	for (size_t k = 0; k <= n_major; k++) indptr_[k] = rp(k);
+	for (size_t k = 0; k < indices_.size(); k++) indices_[k] = (uint32_t)ri(k);
+	for (size_t k = 0; k < data_.size(); k++) data_[k] = rd(k);
+	return Matrix(nrows, ncols, std::move(indptr_), std::move(indices_), std::move(data_));
+}
+
+CSCMatrix<double> numpyToCSCMatrix(py::array_t<int64_t> indptr, py::array_t<int64_t> indices, py::array_t<double> data,
+	size_t nrows, size_t ncols) {
+	return numpyToCompressed<CSCMatrix<double>>(indptr, indices, data, nrows, ncols, ncols);
+}
+
+CSRMatrix<double> numpyToCSRMatrix(py::array_t<int64_t> indptr, py::array_t<int64_t> indices, py::array_t<double> data,
+	size_t nrows, size_t ncols) {
+	return numpyToCompressed<CSRMatrix<double>>(indptr, indices, data, nrows, ncols, nrows);
+}
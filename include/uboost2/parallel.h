@@ -0,0 +1,30 @@
+#pragma once
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace parallel {
+
+	inline int max_threads() {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+
+	inline int thread_id() {
+#ifdef _OPENMP
+		return omp_get_thread_num();
+#else
+		return 0;
+#endif
+	}
+
+	// n_threads <= 0 means all the available cores
+	inline int resolve_n_threads(int n_threads) {
+		if (n_threads <= 0) return max_threads();
+		return n_threads;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// per-phase timings and per-depth counters of a tree builder, read back after update()
+// compiled in with -DUBOOST2_PROFILE; without it the PROFILE_* macros expand to nothing and the
+// stats stay empty, so the builders pay nothing
+namespace profiling {
+
+#ifdef UBOOST2_PROFILE
+	constexpr bool enabled = true;
+#else
+	constexpr bool enabled = false;
+#endif
+
+	struct BuilderStats {
+		// seconds per phase of the last update()
+		std::map<std::string, double> seconds;
+		// per depth: rows read by the split scan (once per column), candidate splits evaluated
+		// (the ones passing min_samples_leaf/min_weight_leaf), nodes expanded
+		std::vector<size_t> rows_scanned, candidate_splits, nodes_expanded;
+		//
+		void clear() {
+			seconds.clear();
+			rows_scanned.clear();
+			candidate_splits.clear();
+			nodes_expanded.clear();
+		}
+		static void count(std::vector<size_t>& counter, size_t depth, size_t n) {
+			if (counter.size() <= depth) counter.resize(depth + 1, 0);
+			counter[depth] += n;
+		}
+	};
+
+	// adds the time spent until stop(), or the end of its scope, to a phase
+	class ScopedTimer {
+		BuilderStats& stats;
+		const char* phase;
+		std::chrono::steady_clock::time_point start;
+		bool running = true;
+	public:
+		ScopedTimer(BuilderStats& stats, const char* phase) : stats{ stats }, phase{ phase }, start{ std::chrono::steady_clock::now() } {}
+		~ScopedTimer() {
+			stop();
+		}
+		void stop() {
+			if (!running) return;
+			running = false;
+			stats.seconds[phase] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+	};
+}
+
+#ifdef UBOOST2_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// times the rest of the enclosing scope as the given phase
+#define PROFILE_SCOPE(stats, phase) profiling::ScopedTimer PROFILE_CONCAT(profile_timer_, __LINE__)(stats, phase)
+// times the phase from here to PROFILE_STOP(timer)
+#define PROFILE_START(stats, timer, phase) profiling::ScopedTimer timer(stats, phase)
+#define PROFILE_STOP(timer) timer.stop()
+#define PROFILE_COUNT(stats, counter, depth, n) profiling::BuilderStats::count((stats).counter, depth, n)
+// a statement only kept when profiling (e.g. a thread-local counter in a hot loop)
+#define PROFILE_ONLY(...) __VA_ARGS__
+#else
+#define PROFILE_SCOPE(stats, phase) ((void)0)
+#define PROFILE_START(stats, timer, phase) ((void)0)
+#define PROFILE_STOP(timer) ((void)0)
+#define PROFILE_COUNT(stats, counter, depth, n) ((void)0)
+#define PROFILE_ONLY(...)
+#endif
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+// compressed sparse matrices: only the stored entries exist, everything else is the default (absent) value
+// copies are shallow, like DMatrix: every copy refers to the same storage
+
+template <typename T = double>
+class CompressedStorage {
+public:
+	// entries of the major index k (a column for CSC, a row for CSR) are in [indptr[k], indptr[k + 1])
+	std::vector<size_t> indptr;
+	std::vector<uint32_t> indices;
+	std::vector<T> values;
+};
+
+template <typename T = double>
+class CSCMatrix {
+	std::shared_ptr<CompressedStorage<T>> m_storage;
+	size_t m_nrows, m_ncols;
+public:
+	CSCMatrix(size_t nrows, size_t ncols, std::vector<size_t> indptr, std::vector<uint32_t> indices, std::vector<T> values) :
+		m_storage{ std::make_shared<CompressedStorage<T>>() }, m_nrows{ nrows }, m_ncols{ ncols } {
+		assert(indptr.size() == ncols + 1);
+		assert(indices.size() == values.size() && indptr.back() == values.size());
+		m_storage->indptr = std::move(indptr);
+		m_storage->indices = std::move(indices);
+		m_storage->values = std::move(values);
+	}
+	//
+	size_t nrows() const {
+		return m_nrows;
+	}
+	size_t ncols() const {
+		return m_ncols;
+	}
+	size_t nnz() const {
+		return m_storage->values.size();
+	}
+	// stored entries of column j: rows row_data(j)[k] and values column_data(j)[k], k < column_size(j)
+	inline size_t column_size(size_t j) const {
+		return m_storage->indptr[j + 1] - m_storage->indptr[j];
+	}
+	inline const uint32_t* row_data(size_t j) const {
+		return m_storage->indices.data() + m_storage->indptr[j];
+	}
+	inline const T* column_data(size_t j) const {
+		return m_storage->values.data() + m_storage->indptr[j];
+	}
+	const std::vector<size_t>& indptr() const {
+		return m_storage->indptr;
+	}
+	const std::vector<uint32_t>& indices() const {
+		return m_storage->indices;
+	}
+	const std::vector<T>& values() const {
+		return m_storage->values;
+	}
+};
+
+template <typename T = double>
+class CSRMatrix {
+	std::shared_ptr<CompressedStorage<T>> m_storage;
+	size_t m_nrows, m_ncols;
+public:
+	CSRMatrix(size_t nrows, size_t ncols, std::vector<size_t> indptr, std::vector<uint32_t> indices, std::vector<T> values) :
+		m_storage{ std::make_shared<CompressedStorage<T>>() }, m_nrows{ nrows }, m_ncols{ ncols } {
+		assert(indptr.size() == nrows + 1);
+		assert(indices.size() == values.size() && indptr.back() == values.size());
+		m_storage->indptr = std::move(indptr);
+		m_storage->indices = std::move(indices);
+		m_storage->values = std::move(values);
+	}
+	//
+	size_t nrows() const {
+		return m_nrows;
+	}
+	size_t ncols() const {
+		return m_ncols;
+	}
+	size_t nnz() const {
+		return m_storage->values.size();
+	}
+	// stored value of (i, j), nullptr when absent; the column indices of a row must be sorted
+	inline const T* find(size_t i, size_t j) const {
+		const uint32_t* begin = m_storage->indices.data() + m_storage->indptr[i];
+		const uint32_t* end = m_storage->indices.data() + m_storage->indptr[i + 1];
+		const uint32_t* it = std::lower_bound(begin, end, (uint32_t)j);
+		if (it == end || *it != j) return nullptr;
+		return m_storage->values.data() + (it - m_storage->indices.data());
+	}
+	const std::vector<size_t>& indptr() const {
+		return m_storage->indptr;
+	}
+	const std::vector<uint32_t>& indices() const {
+		return m_storage->indices;
+	}
+	const std::vector<T>& values() const {
+		return m_storage->values;
+	}
+};
+
+namespace sparse {
+	// counting-sort transpose of the compressed arrays: n_major x n_minor into n_minor x n_major,
+	// the minor indices of the result come out sorted
+	template <typename T>
+	void transpose(size_t n_major, size_t n_minor,
+		const std::vector<size_t>& indptr, const std::vector<uint32_t>& indices, const std::vector<T>& values,
+		std::vector<size_t>& t_indptr, std::vector<uint32_t>& t_indices, std::vector<T>& t_values) {
+		t_indptr.assign(n_minor + 1, 0);
+		for (uint32_t j : indices) t_indptr[j + 1]++;
+		for (size_t j = 0; j < n_minor; j++) t_indptr[j + 1] += t_indptr[j];
+		t_indices.resize(indices.size());
+		t_values.resize(values.size());
+		std::vector<size_t> next(t_indptr.begin(), t_indptr.end() - 1);
+		for (size_t k = 0; k < n_major; k++) {
+			for (size_t q = indptr[k]; q < indptr[k + 1]; q++) {
+				const size_t dst = next[indices[q]]++;
+				t_indices[dst] = (uint32_t)k;
+				t_values[dst] = values[q];
+			}
+		}
+	}
+
+	template <typename T>
+	CSRMatrix<T> to_csr(const CSCMatrix<T>& x) {
+		std::vector<size_t> indptr;
+		std::vector<uint32_t> indices;
+		std::vector<T> values;
+		transpose(x.ncols(), x.nrows(), x.indptr(), x.indices(), x.values(), indptr, indices, values);
+		return CSRMatrix<T>(x.nrows(), x.ncols(), std::move(indptr), std::move(indices), std::move(values));
+	}
+
+	template <typename T>
+	CSCMatrix<T> to_csc(const CSRMatrix<T>& x) {
+		std::vector<size_t> indptr;
+		std::vector<uint32_t> indices;
+		std::vector<T> values;
+		transpose(x.nrows(), x.ncols(), x.indptr(), x.indices(), x.values(), indptr, indices, values);
+		return CSCMatrix<T>(x.nrows(), x.ncols(), std::move(indptr), std::move(indices), std::move(values));
+	}
+}
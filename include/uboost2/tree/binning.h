@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cmath>
+#include <cassert>
+
+#include <uboost2/data.h>
+#include <uboost2/parallel.h>
+#include <uboost2/tree/quantile_sketch.h>
+
+constexpr size_t MAX_BINS = 256;
+// bins of present values at most, the last code is left for the missing bin
+constexpr size_t MAX_PRESENT_BINS = MAX_BINS - 1;
+
+// quantized copy of a feature matrix: every value is replaced by the index of its bin
+// bin b of column j holds the values x with cuts[j][b - 1] <= x < cuts[j][b]
+// missing values have a bin of their own after those, so the splits can send them either way
+class BinMatrix : public DMatrix<uint8_t> {
+	std::vector<std::vector<double>> cuts;
+	std::vector<size_t> offsets;
+	size_t max_bins = MAX_BINS;
+protected:
+	template <typename X>
+	void fill(const DMatrix<X>& x, int n_threads) {
+		offsets.resize(m_ncols + 1, 0);
+		for (size_t col = 0; col < m_ncols; col++) offsets[col + 1] = offsets[col] + get_n_bins(col);
+		#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+		for (int col = 0; col < (int)m_ncols; col++) {
+			for (size_t i = 0; i < m_nrows; i++) (*this)(i, col) = (uint8_t)get_bin(col, x(i, col));
+		}
+	}
+public:
+	// the cuts come from a quantile sketch (see quantile_sketch.h): exact for columns with few rows or
+	// few distinct values, within a small rank error otherwise
+	template <typename X>
+	BinMatrix(const DMatrix<X>& x, size_t max_bins = MAX_BINS, int n_threads = 1) : DMatrix<uint8_t>{ x.nrows(), x.ncols() } {
+		assert(max_bins >= 2 && max_bins <= MAX_BINS);
+		this->max_bins = max_bins;
+		n_threads = parallel::resolve_n_threads(n_threads);
+		cuts = sketches::cuts(x, std::min(max_bins, MAX_PRESENT_BINS), n_threads);
+		fill(x, n_threads);
+	}
+	// bins of about equal weight w
+	template <typename X>
+	BinMatrix(const DMatrix<X>& x, const DColumn<>& w, size_t max_bins = MAX_BINS, int n_threads = 1) :
+		DMatrix<uint8_t>{ x.nrows(), x.ncols() } {
+		assert(max_bins >= 2 && max_bins <= MAX_BINS);
+		this->max_bins = max_bins;
+		n_threads = parallel::resolve_n_threads(n_threads);
+		cuts = sketches::cuts(x, w, std::min(max_bins, MAX_PRESENT_BINS), n_threads);
+		fill(x, n_threads);
+	}
+	// prepared bin indices and their cuts (e.g. mapped from a dataset file)
+	BinMatrix(const DMatrix<uint8_t>& bins, std::vector<std::vector<double>> cuts, size_t max_bins) :
+		DMatrix<uint8_t>{ bins }, cuts{ std::move(cuts) } {
+		assert(this->cuts.size() == m_ncols);
+		this->max_bins = max_bins;
+		offsets.resize(m_ncols + 1, 0);
+		for (size_t col = 0; col < m_ncols; col++) offsets[col + 1] = offsets[col] + get_n_bins(col);
+	}
+	//
+	inline size_t get_bin(size_t col, double x) const {
+		const auto& c = cuts[col];
+		if (is_missing(x)) return c.size() + 1;
+		return std::upper_bound(c.begin(), c.end(), x) - c.begin();
+	}
+	// the present bins and the missing one
+	inline size_t get_n_bins(size_t col) const {
+		return cuts[col].size() + 2;
+	}
+	inline size_t get_missing_bin(size_t col) const {
+		return cuts[col].size() + 1;
+	}
+	inline const std::vector<double>& get_cuts(size_t col) const {
+		return cuts[col];
+	}
+	// threshold separating bin b - 1 from bin b
+	inline double get_threshold(size_t col, size_t b) const {
+		if (b == 0) return -INFINITY;
+		return cuts[col][b - 1];
+	}
+	// position of the first bin of a column in a flat histogram of all columns
+	inline size_t get_offset(size_t col) const {
+		return offsets[col];
+	}
+	inline size_t get_total_bins() const {
+		return offsets.back();
+	}
+	size_t get_max_bins() const {
+		return max_bins;
+	}
+};
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <uboost2/tree/builder/builder.h>
+#include <uboost2/tree/sorted_index.h>
 
 class BaseTreeBuilder : public NodeWiseTreeBuilder {
-	EntryMatrix entries;
+	const DMatrix<>& x;
+	SortedIndex index;
+	DColumn<> y, w;
 	std::vector<size_t> position;
 	double y_mean;
 	size_t nrows, ncols;
@@ -12,12 +15,11 @@ class BaseTreeBuilder : public NodeWiseTreeBuilder {
 	size_t min_samples_leaf = 1;
 	//
 public:
-	BaseTreeBuilder(const DMatrix<>& x, const DColumn<>& y) : entries{ x, y } {
+	BaseTreeBuilder(const DMatrix<>& x, const DColumn<>& y) : x{ x }, index{ x }, y{ y }, w{ matrix::ones(x.nrows()) } {
 		nrows = x.nrows();
 		ncols = x.ncols();
 		y_mean = y.sum() / nrows;
 		node_proposer = new LowerFirstNodeProposer();
-		entries.sort_columns();
 	}
 protected:
 	void init(Tree& tree) override {
@@ -35,17 +37,21 @@ protected:
 		}
 
 		MSESplitter splitter;
-		const auto& ecol = DColumn<Entry>(entries, 0);
-		for (auto e : ecol) if (position[e.i] == nid) {
-			splitter.add(e);
+		const double* y = this->y.data();
+		const double* w = this->w.data();
+		for (size_t i = 0; i < nrows; i++) if (position[i] == nid) {
+			splitter.add(y[i], w[i]);
 		}
 
 		Split best_split = Split::build_unsuccessful_split();
 		for (size_t col = 0; col < ncols; col++) {
-			auto entry_column = DColumn<Entry>(entries, col);
+			const uint32_t* order = index.column_data(col);
+			const double* xcol = x.column_data(col);
 			splitter.start_splitting(col);
-			for (const Entry& e : entry_column) if (position[e.i] == nid) {
-				const Split candidate_split = splitter.build_split(e);
+			for (size_t k = 0; k < nrows; k++) {
+				const uint32_t i = order[k];
+				if (position[i] != nid) continue;
+				const Split candidate_split = splitter.build_split(i, xcol[i], y[i], w[i]);
 				if (!candidate_split.succesful) continue;
 				if (candidate_split > best_split) best_split = candidate_split;
 			}
@@ -80,11 +86,11 @@ protected:
 		node_proposer->push(rchild, best_split.r_criterion);
 
 		// update position
-		auto entry_column = DColumn<Entry>(entries, best_split.column);
-		for (const Entry& e : entry_column) {
-			if (position[e.i] == nid) {
-				if (e.x >= best_split.threshold) position[e.i] = rchild;
-				else position[e.i] = lchild;
+		const double* xcol = x.column_data(best_split.column);
+		for (size_t i = 0; i < nrows; i++) {
+			if (position[i] == nid) {
+				if (is_missing(xcol[i]) || xcol[i] >= best_split.threshold) position[i] = rchild;
+				else position[i] = lchild;
 			}
 		}
 	}
@@ -4,11 +4,13 @@
 
 #include <uboost2/tree/builder/builder.h>
 #include <uboost2/tree/column_proposer.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/parallel.h>
 
 
+template <typename X = double>
 class LayerWiseTreeBuilder : public TreeBuilder {
-	const DMatrix<>& x;
-	EntryMatrix* entries;
+	Dataset<X> data;
 	size_t nrows, ncols;
 	double y_mean;
 	std::vector<int> position;
@@ -18,49 +20,62 @@ class LayerWiseTreeBuilder : public TreeBuilder {
 	double min_weight_leaf = 0.0, min_weight_split = 0.0;
 	double colsample_bytree = 1.0, colsample_bylevel = 1.0;
 	double reg_alpha = 0.0;
+	unsigned seed = 0;
+	int n_threads = 1;
 protected:
 	void init(Tree& tree) {
+		double s = 0.0, w = 0.0;
+		for (size_t i = 0; i < nrows; i++) {
+			s += data.get_y()(i) * data.get_w()(i);
+			w += data.get_w()(i);
+		}
+		y_mean = s / w;
 		tree[trees::ROOTID].value = y_mean;
+		// rows of weight 0 (out of the bootstrap/subsample) never enter the tree
 		position.clear();
 		position.resize(nrows, trees::ROOTID);
+		for (size_t i = 0; i < nrows; i++) {
+			if (data.get_w()(i) <= 0.0) position[i] = -1;
+		}
+		nodes.clear();
 		nodes.reserve(100);
 		nodes.push_back(trees::ROOTID);
 	}
+	// a child is split further only when it is in nodes: rows of the other children are dropped
+	bool is_kept(size_t n, double weight) const {
+		return n >= this->min_samples_split && weight >= min_weight_split;
+	}
 public:
-	LayerWiseTreeBuilder(const DMatrix<>& x, const DColumn<>& y, 
+	LayerWiseTreeBuilder(const DMatrix<X>& x, const DColumn<>& y, 
 		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
 		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
-		double colsample_bytree = 1.0, double colsample_bylevel = 1.0, double reg_alpha=0.0) : entries{ new EntryMatrix(x, y) }, x{ x } {
-		nrows = x.nrows();
-		ncols = x.ncols();
-		y_mean = entries->get_y_mean();
-		entries->sort_columns();
-		this->min_samples_leaf = min_samples_leaf;
-		this->min_samples_split = min_samples_split;
-		this->min_weight_leaf = min_weight_leaf;
-		this->min_weight_split = min_weight_split;
-		this->colsample_bytree = colsample_bytree;
-		this->colsample_bylevel = colsample_bylevel;
-		this->reg_alpha = reg_alpha;
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0, double reg_alpha=0.0,
+		unsigned seed = 0, int n_threads = 1) : LayerWiseTreeBuilder(
+			Dataset<X>(x, n_threads), min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+			colsample_bytree, colsample_bylevel, reg_alpha, seed, n_threads) {
+		data.set_y(y);
 	}
-	LayerWiseTreeBuilder(EntryMatrix& e, size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+	LayerWiseTreeBuilder(const Dataset<X>& data,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
 		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
-		double colsample_bytree = 1.0, double colsample_bylevel = 1.0) : entries{ &e }, x{ x } {
-		nrows = e.nrows();
-		ncols = e.ncols();
-		y_mean = entries->get_y_mean();
-		entries->sort_columns();
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0, double reg_alpha=0.0,
+		unsigned seed = 0, int n_threads = 1) : data{ data } {
+		nrows = data.nrows();
+		ncols = data.ncols();
 		this->min_samples_leaf = min_samples_leaf;
 		this->min_samples_split = min_samples_split;
 		this->min_weight_leaf = min_weight_leaf;
 		this->min_weight_split = min_weight_split;
 		this->colsample_bytree = colsample_bytree;
 		this->colsample_bylevel = colsample_bylevel;
+		this->reg_alpha = reg_alpha;
+		this->seed = seed;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
 	}
 	void update(Tree& tree) override {
 		assert(tree[trees::ROOTID].is_leaf);
 
-		ColumnProposer column_proposer(ncols, colsample_bytree, colsample_bylevel);
+		ColumnProposer column_proposer(ncols, colsample_bytree, colsample_bylevel, seed);
 
 		//std::unordered_map<size_t, Split> best_splits;
 		std::vector<Split> best_splits;
@@ -68,32 +83,83 @@ public:
 		//std::unordered_map<size_t, MSESplitter> splitters;
 		std::vector<MSESplitter> splitters;
 		splitters.resize(trees::max_idx_at_depth(tree.get_max_depth()), MSESplitter(min_samples_leaf, min_weight_leaf));
+		std::vector<int> slot(trees::max_idx_at_depth(tree.get_max_depth()), -1);
 		
 		init(tree);
 		for (size_t curr_depth = 0; curr_depth < tree.get_max_depth(); curr_depth++) {
 			if (nodes.size() == 0) break;
-			for (const auto& e : DColumn<Entry>(*entries, 0)) {
-				if (position[e.i] >= 0) {
-					splitters[position[e.i]].add(e);
+			const DMatrix<X>& x = data.get_x();
+			const SortedIndex& index = data.get_index();
+			const double* y = data.get_y().data();
+			const double* w = data.get_w().data();
+			for (size_t i = 0; i < nrows; i++) {
+				if (position[i] >= 0) {
+					splitters[position[i]].add(y[i], w[i]);
 				}
 			}
 
 			// search splits
+			// columns are split statically among the threads, each one with its own splitters and
+			// best splits, merged in thread order: the result does not depend on the number of threads
 			const auto columns = column_proposer.get_columns();
-			for (size_t col : columns) {
-				for (auto nid : nodes) splitters[nid].start_splitting(col);
-				for (size_t i = 0; i < nrows; i++) {
-					const auto& e = entries->operator()(i, col);
-					const int& nid = position[e.i];
-					if (nid < 0) continue;
-					const Split& candidate_split = splitters[nid].build_split(e);
-					if (!candidate_split.succesful) continue;
-					if (candidate_split > best_splits[nid]) best_splits[nid] = candidate_split;
+			for (size_t k = 0; k < nodes.size(); k++) slot[nodes[k]] = k;
+			std::vector<std::vector<Split>> thread_best_splits(n_threads);
+			#pragma omp parallel num_threads(n_threads)
+			{
+				std::vector<MSESplitter> local_splitters;
+				std::vector<Bin> missing(nodes.size());
+				std::vector<Split>& local_best_splits = thread_best_splits[parallel::thread_id()];
+				for (size_t nid : nodes) {
+					local_splitters.push_back(splitters[nid]);
+					local_best_splits.push_back(best_splits[nid]);
+				}
+				#pragma omp for schedule(static)
+				for (int k = 0; k < (int)columns.size(); k++) {
+					const size_t col = columns[k];
+					const uint32_t* order = index.column_data(col);
+					const X* xcol = x.column_data(col);
+					// the missing values are sorted last: scanned with them on the right, then on the left
+					const size_t n_present = nrows - index.get_n_missing(col);
+					for (auto& splitter : local_splitters) splitter.start_splitting(col);
+					for (size_t r = 0; r < n_present; r++) {
+						const uint32_t i = order[r];
+						const int& nid = position[i];
+						if (nid < 0) continue;
+						const int& s = slot[nid];
+						const Split& candidate_split = local_splitters[s].build_split(i, xcol[i], y[i], w[i]);
+						if (!candidate_split.succesful) continue;
+						if (candidate_split > local_best_splits[s]) local_best_splits[s] = candidate_split;
+					}
+					if (n_present == nrows) continue;
+					std::fill(missing.begin(), missing.end(), Bin());
+					for (size_t r = n_present; r < nrows; r++) {
+						const uint32_t i = order[r];
+						if (position[i] >= 0) missing[slot[position[i]]].add(y[i], w[i]);
+					}
+					for (size_t k = 0; k < nodes.size(); k++) {
+						if (missing[k].n > 0) local_splitters[k].start_splitting(col, missing[k]);
+					}
+					for (size_t r = 0; r < n_present; r++) {
+						const uint32_t i = order[r];
+						const int& nid = position[i];
+						if (nid < 0) continue;
+						const int& s = slot[nid];
+						if (missing[s].n == 0) continue;
+						const Split& candidate_split = local_splitters[s].build_split(i, xcol[i], y[i], w[i]);
+						if (!candidate_split.succesful) continue;
+						if (candidate_split > local_best_splits[s]) local_best_splits[s] = candidate_split;
+					}
+				}
+			}
+			for (const auto& local_best_splits : thread_best_splits) {
+				for (size_t k = 0; k < local_best_splits.size(); k++) {
+					if (local_best_splits[k] > best_splits[nodes[k]]) best_splits[nodes[k]] = local_best_splits[k];
 				}
 			}
 			
-			// update position			
-			for (size_t i = 0; i < nrows; i++) {
+			// update position
+			#pragma omp parallel for num_threads(n_threads)
+			for (int i = 0; i < (int)nrows; i++) {
 				int nid = position[i];
 				if (nid < 0) continue;
 				const Split& split = best_splits[nid];
@@ -101,13 +167,14 @@ public:
 					position[i] = -1;
 					continue;
 				}	
-				if (x(i, split.column) >= split.threshold) {
-					if (split.r_n >= this->min_samples_split) position[i] = trees::right_child(nid);
+				const double xi = x(i, split.column);
+				if (is_missing(xi) ? !split.default_left : xi >= split.threshold) {
+					if (is_kept(split.r_n, split.r_w)) position[i] = trees::right_child(nid);
 					else position[i] = -1;
 				}
 				else {
-					if (split.l_n >= this->min_samples_split) position[i] = trees::left_child(nid);
-					else position[i] = -1;					
+					if (is_kept(split.l_n, split.l_w)) position[i] = trees::left_child(nid);
+					else position[i] = -1;
 				}
 			}
 
@@ -118,6 +185,7 @@ public:
 					tree[nid].is_leaf = false;
 					tree[nid].column = split.column;
 					tree[nid].threshold = split.threshold;
+					tree[nid].default_left = split.default_left;
 					tree[nid].value = split.p_value;
 					tree[nid].criterion = split.p_criterion;
 					tree[nid].gain = split.criterion_gain;
@@ -144,9 +212,9 @@ public:
 			for (auto parent : nodes_old) {
 				const Split& split = best_splits[parent];
 				if (split.succesful) {
-					if (split.r_n >= this->min_samples_split && split.r_w >= min_weight_split)
+					if (is_kept(split.r_n, split.r_w))
 						nodes.push_back(trees::right_child(parent));
-					if (split.l_n >= this->min_samples_split && split.l_w >= min_weight_split) 
+					if (is_kept(split.l_n, split.l_w))
 						nodes.push_back(trees::left_child(parent));
 				}
 			}
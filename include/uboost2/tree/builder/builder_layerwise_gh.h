@@ -1,42 +1,182 @@
 #pragma once
 
 #include <random>
+#include <algorithm>
 
 #include <uboost2/tree/builder/builder.h>
 #include <uboost2/tree/column_proposer.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/tree/goss.h>
+#include <uboost2/parallel.h>
+#include <uboost2/profiling.h>
 
 
+template <typename X = double>
 class GHLayerWiseTreeBuilder : public TreeBuilder {
-	const DMatrix<>& x;
-	GHEntryMatrix* entries;
+	Dataset<X> data;
 	size_t nrows, ncols;
 	double v_mean;
 	std::vector<int> position;
 	std::vector<size_t> nodes;
+	// the live rows of every column of the sorted index, packed at the front and grouped by node:
+	// a node owns the same range in all the columns, so a level only scans the rows still in play
+	struct range {
+		size_t start;
+		size_t end;
+	};
+	DMatrix<uint32_t> order;
+	std::vector<range> ranges;
+	std::vector<char> side;
+	size_t n_live = 0;
 	//
 	size_t min_samples_leaf = 1, min_samples_split=2;
 	double min_weight_leaf = 0.0, min_weight_split = 0.0;
 	double colsample_bytree = 1.0, colsample_bylevel = 1.0;
 	double reg_lambda = 1.0, reg_alpha = -INFINITY;
+	double top_rate = 1.0, other_rate = 0.0;
+	DColumn<> sample_w;
+	std::default_random_engine generator;
+	unsigned seed = 0;
+	int n_threads = 1;
+	profiling::BuilderStats stats;
 protected:
+	// row weights of the current tree: the dataset ones, or the GOSS ones when sampling
+	const double* weights() const {
+		return goss::enabled(top_rate, other_rate) ? sample_w.data() : data.get_w().data();
+	}
+	// rows to the left child, to the right child, or out of the tree
+	static constexpr char LEFT = 0, RIGHT = 1, DROP = 2;
+
 	void init(Tree& tree) {
-		tree[trees::ROOTID].value = v_mean;
 		position.clear();
 		position.resize(nrows, trees::ROOTID);
+		if (goss::enabled(top_rate, other_rate)) {
+			goss::sample(data.get_g(), data.get_w(), top_rate, other_rate, generator, position, sample_w);
+		}
+		// the rows left out by the sampling, or of weight 0 (out of the subsample), never enter the ranges
+		const double* w = weights();
+		const SortedIndex& index = data.get_index();
+		n_live = 0;
+		for (size_t i = 0; i < nrows; i++) {
+			if (w[i] <= 0.0) position[i] = -1;
+			n_live += position[i] >= 0;
+		}
+		#pragma omp parallel for num_threads(n_threads)
+		for (int col = 0; col < (int)ncols; col++) {
+			const uint32_t* in = index.column_data(col);
+			uint32_t* out = order.column_data(col);
+			if (n_live == nrows) std::copy(in, in + nrows, out);
+			else {
+				for (size_t r = 0; r < nrows; r++) {
+					if (position[in[r]] >= 0) *out++ = in[r];
+				}
+			}
+		}
+		ranges.assign(trees::max_idx_at_depth(tree.get_max_depth()) + 1, range{ 0, 0 });
+		ranges[trees::ROOTID] = range{ 0, n_live };
+
+		const double* g = data.get_g().data();
+		const double* h = data.get_h().data();
+		double G = 0.0, H = 0.0;
+		for (size_t i = 0; i < nrows; i++) {
+			if (position[i] < 0) continue;
+			G += g[i] * w[i];
+			H += h[i] * w[i];
+		}
+		v_mean = G / (reg_lambda + H);
+		tree[trees::ROOTID].value = v_mean;
+		nodes.clear();
 		nodes.reserve(100);
 		nodes.push_back(trees::ROOTID);
 	}
+	// moves the rows of the split nodes to their children, in every column: the children of a node
+	// are packed in its place (left then right, sorted order kept), the dropped rows disappear
+	void partition(std::vector<size_t> parents, const std::vector<Split>& best_splits) {
+		// in range order, so the compaction never overwrites rows not read yet
+		std::sort(parents.begin(), parents.end(), [&](size_t a, size_t b) { return ranges[a].start < ranges[b].start; });
+		const DMatrix<X>& x = data.get_x();
+		const uint32_t* order0 = order.column_data(0);
+		#pragma omp parallel num_threads(n_threads)
+		for (size_t parent : parents) {
+			const Split& split = best_splits[parent];
+			const bool keep_left = split.succesful && is_kept(split.l_n, split.l_w);
+			const bool keep_right = split.succesful && is_kept(split.r_n, split.r_w);
+			const range r = ranges[parent];
+			const X* xsplit = split.succesful ? x.column_data(split.column) : nullptr;
+			#pragma omp for schedule(static) nowait
+			for (int k = (int)r.start; k < (int)r.end; k++) {
+				const uint32_t i = order0[k];
+				if (!split.succesful) {
+					side[i] = DROP;
+					continue;
+				}
+				const bool right = is_missing(xsplit[i]) ? !split.default_left : xsplit[i] >= split.threshold;
+				if (right) side[i] = keep_right ? RIGHT : DROP;
+				else side[i] = keep_left ? LEFT : DROP;
+			}
+		}
+
+		std::vector<range> left(parents.size()), right(parents.size());
+		#pragma omp parallel num_threads(n_threads)
+		{
+			std::vector<uint32_t> buffer;
+			#pragma omp for schedule(static)
+			for (int col = 0; col < (int)ncols; col++) {
+				uint32_t* ocol = order.column_data(col);
+				// the write position never passes the read one, the ranges are compacted in place
+				size_t out = 0;
+				for (size_t k = 0; k < parents.size(); k++) {
+					const range r = ranges[parents[k]];
+					buffer.clear();
+					const size_t start = out;
+					for (size_t q = r.start; q < r.end; q++) {
+						const uint32_t i = ocol[q];
+						if (side[i] == LEFT) ocol[out++] = i;
+						else if (side[i] == RIGHT) buffer.push_back(i);
+					}
+					std::copy(buffer.begin(), buffer.end(), ocol + out);
+					if (col == 0) {
+						left[k] = range{ start, out };
+						right[k] = range{ out, out + buffer.size() };
+					}
+					out += buffer.size();
+				}
+			}
+		}
+		n_live = 0;
+		for (size_t k = 0; k < parents.size(); k++) {
+			ranges[trees::left_child(parents[k])] = left[k];
+			ranges[trees::right_child(parents[k])] = right[k];
+			n_live = std::max(n_live, right[k].end);
+		}
+	}
+	bool is_kept(size_t n, double weight) const {
+		return n >= this->min_samples_split && weight >= min_weight_split;
+	}
 public:
 	GHLayerWiseTreeBuilder(
-		const DMatrix<double>& x, const DColumn<double>& g, const DColumn<>& h,
+		const DMatrix<X>& x, const DColumn<double>& g, const DColumn<>& h,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0,
+		double top_rate = 1.0, double other_rate = 0.0, unsigned seed = 0, int n_threads = 1) : GHLayerWiseTreeBuilder(
+			Dataset<X>(x, n_threads), min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+			colsample_bytree, colsample_bylevel, reg_lambda, reg_alpha, top_rate, other_rate, seed, n_threads) {
+		data.set_g(g);
+		data.set_h(h);
+	}
+	GHLayerWiseTreeBuilder(
+		const Dataset<X>& data,
 		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
 		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
 		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
-		double reg_lambda = 1.0, double reg_alpha = 0.0) : entries{ new GHEntryMatrix(x, g, h) }, x{ x } {
-		nrows = x.nrows();
-		ncols = x.ncols();
-		v_mean = g.sum() / (this->reg_lambda + h.sum());
-		entries->sort_columns();
+		double reg_lambda = 1.0, double reg_alpha = 0.0,
+		double top_rate = 1.0, double other_rate = 0.0, unsigned seed = 0, int n_threads = 1) :
+		data{ data }, order{ data.nrows(), data.ncols() }, sample_w{ data.nrows(), 0.0 }, generator{ seed } {
+		nrows = data.nrows();
+		ncols = data.ncols();
+		side.resize(nrows, DROP);
 		this->min_samples_leaf = min_samples_leaf;
 		this->min_samples_split = min_samples_split;
 		this->min_weight_leaf = min_weight_leaf;
@@ -45,69 +185,121 @@ public:
 		this->colsample_bylevel = colsample_bylevel;
 		this->reg_lambda = reg_lambda;
 		this->reg_alpha = reg_alpha;
+		this->top_rate = top_rate;
+		this->other_rate = other_rate;
+		this->seed = seed;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
 	}
 	//
 	void update(Tree& tree) override {
 		assert(tree[trees::ROOTID].is_leaf);
+		stats.clear();
+		PROFILE_SCOPE(stats, "total");
 
-		ColumnProposer column_proposer(ncols, colsample_bytree, colsample_bylevel);
+		ColumnProposer column_proposer(ncols, colsample_bytree, colsample_bylevel, seed);
 
-		//std::unordered_map<size_t, Split> best_splits;
 		std::vector<Split> best_splits;
 		best_splits.resize(trees::max_idx_at_depth(tree.get_max_depth()), Split::build_unsuccessful_split(reg_alpha));
-		//std::unordered_map<size_t, MSESplitter> splitters;
-		std::vector<GHSplitter> splitters;
-		splitters.resize(trees::max_idx_at_depth(tree.get_max_depth()), GHSplitter(this->min_samples_leaf, this->min_weight_leaf));
 
+		// the index is sorted on first use: timed on its own, out of init
+		PROFILE_START(stats, sort_timer, "sort");
+		data.get_index();
+		PROFILE_STOP(sort_timer);
+		PROFILE_START(stats, init_timer, "init");
 		init(tree);
+		PROFILE_STOP(init_timer);
 		for (size_t curr_depth = 0; curr_depth < tree.get_max_depth(); curr_depth++) {
 			if (nodes.size() == 0) break;
-			for (const auto& e : DColumn<GHEntry>(*entries, 0)) {
-				if (position[e.i] >= 0) {
-					splitters[position[e.i]].add(e);
+			const DMatrix<X>& x = data.get_x();
+			const double* g = data.get_g().data();
+			const double* h = data.get_h().data();
+			const double* w = weights();
+			std::vector<GHSplitter> splitters(nodes.size(), GHSplitter(this->min_samples_leaf, this->min_weight_leaf, this->reg_lambda));
+			const uint32_t* order0 = order.column_data(0);
+			PROFILE_START(stats, sums_timer, "node_sums");
+			for (size_t k = 0; k < nodes.size(); k++) {
+				const range& r = ranges[nodes[k]];
+				for (size_t q = r.start; q < r.end; q++) {
+					const uint32_t i = order0[q];
+					splitters[k].add(g[i], h[i], w[i]);
 				}
 			}
+			PROFILE_STOP(sums_timer);
 
 			// search splits
+			// columns are split statically among the threads, each one with its own splitters and
+			// best splits, merged in thread order: the result does not depend on the number of threads
 			const auto columns = column_proposer.get_columns();
-			for (size_t col : columns) {
-				for (size_t nid : nodes) splitters[nid].start_splitting(col);
-				for (size_t i = 0; i < nrows; i++) {
-					const GHEntry& e = entries->operator()(i, col);
-					const int& nid = position[e.i];
-					if (nid < 0) continue;
-					const auto candidate_split = splitters[nid].build_split(e);
-					if (!candidate_split.succesful) continue; 
-					if (candidate_split > best_splits[nid]) best_splits[nid] = candidate_split;
+			PROFILE_ONLY(
+				size_t level_rows = 0;
+				for (size_t nid : nodes) level_rows += ranges[nid].end - ranges[nid].start;
+				PROFILE_COUNT(stats, rows_scanned, curr_depth, level_rows * columns.size());
+				std::vector<size_t> thread_candidates(n_threads, 0);
+			)
+			std::vector<std::vector<Split>> thread_best_splits(n_threads);
+			PROFILE_START(stats, scan_timer, "split_scan");
+			#pragma omp parallel num_threads(n_threads)
+			{
+				PROFILE_ONLY(size_t local_candidates = 0;)
+				std::vector<GHSplitter> local_splitters(splitters);
+				std::vector<Split>& local_best_splits = thread_best_splits[parallel::thread_id()];
+				for (size_t nid : nodes) local_best_splits.push_back(best_splits[nid]);
+				#pragma omp for schedule(static)
+				for (int c = 0; c < (int)columns.size(); c++) {
+					const size_t col = columns[c];
+					const uint32_t* ocol = order.column_data(col);
+					const X* xcol = x.column_data(col);
+					for (size_t k = 0; k < nodes.size(); k++) {
+						GHSplitter& splitter = local_splitters[k];
+						Split& best_split = local_best_splits[k];
+						const range& r = ranges[nodes[k]];
+						// the missing values are at the end of the range: scanned with them on the right,
+						// then on the left
+						size_t present_end = r.end;
+						GHBin missing;
+						while (present_end > r.start && is_missing(xcol[ocol[present_end - 1]])) {
+							const uint32_t i = ocol[--present_end];
+							missing.add(g[i], h[i], w[i]);
+						}
+						splitter.start_splitting(col);
+						for (size_t q = r.start; q < present_end; q++) {
+							const uint32_t i = ocol[q];
+							const auto candidate_split = splitter.build_split(i, xcol[i], g[i], h[i], w[i]);
+							if (!candidate_split.succesful) continue;
+							PROFILE_ONLY(local_candidates++;)
+							if (candidate_split > best_split) best_split = candidate_split;
+						}
+						if (missing.n == 0) continue;
+						splitter.start_splitting(col, missing);
+						for (size_t q = r.start; q < present_end; q++) {
+							const uint32_t i = ocol[q];
+							const auto candidate_split = splitter.build_split(i, xcol[i], g[i], h[i], w[i]);
+							if (!candidate_split.succesful) continue;
+							PROFILE_ONLY(local_candidates++;)
+							if (candidate_split > best_split) best_split = candidate_split;
+						}
+					}
 				}
+				PROFILE_ONLY(thread_candidates[parallel::thread_id()] = local_candidates;)
 			}
-			
-			// update position			
-			for (size_t i = 0; i < nrows; i++) {
-				int nid = position[i];
-				if (nid < 0) continue;
-				const Split& split = best_splits[nid];
-				if (!split.succesful) {
-					position[i] = -1;
-					continue;
-				}	
-				if (x(i, split.column) >= split.threshold) {
-					if (split.r_n >= this->min_samples_split) position[i] = trees::right_child(nid);
-					else position[i] = -1;
-				}
-				else {
-					if (split.l_n >= this->min_samples_split) position[i] = trees::left_child(nid);
-					else position[i] = -1;					
+			for (const auto& local_best_splits : thread_best_splits) {
+				for (size_t k = 0; k < local_best_splits.size(); k++) {
+					if (local_best_splits[k] > best_splits[nodes[k]]) best_splits[nodes[k]] = local_best_splits[k];
 				}
 			}
+			PROFILE_STOP(scan_timer);
+			PROFILE_ONLY(for (size_t n : thread_candidates) PROFILE_COUNT(stats, candidate_splits, curr_depth, n);)
 
 			// update tree
+			PROFILE_START(stats, update_timer, "tree_update");
 			for (auto nid : nodes){
 				const Split& split = best_splits[nid];
 				if (split.succesful) {
+					PROFILE_COUNT(stats, nodes_expanded, curr_depth, 1);
 					tree[nid].is_leaf = false;
 					tree[nid].column = split.column;
 					tree[nid].threshold = split.threshold;
+					tree[nid].default_left = split.default_left;
 					tree[nid].value = split.p_value;
 					tree[nid].criterion = split.p_criterion;
 					tree[nid].gain = split.criterion_gain;
@@ -127,6 +319,13 @@ public:
 					tree[rchild].n = split.r_n;
 				}
 			}
+			PROFILE_STOP(update_timer);
+
+			// the children that can still be split keep their rows, the others are dropped
+			if (curr_depth + 1 < tree.get_max_depth()) {
+				PROFILE_SCOPE(stats, "partition");
+				partition(nodes, best_splits);
+			}
 
 			// update nodes
 			std::vector<size_t> nodes_old(nodes);
@@ -134,13 +333,17 @@ public:
 			for (auto parent : nodes_old) {
 				const Split& split = best_splits[parent];
 				if (split.succesful) {
-					if (split.r_n >= this->min_samples_split && split.r_w >= min_weight_split)
+					if (is_kept(split.r_n, split.r_w))
 						nodes.push_back(trees::right_child(parent));
-					if (split.l_n >= this->min_samples_split && split.l_w >= min_weight_split)
+					if (is_kept(split.l_n, split.l_w))
 						nodes.push_back(trees::left_child(parent));
 				}
 			}
 		}
 
 	}
-};
\ No newline at end of file
+	//
+	const profiling::BuilderStats& get_stats() const {
+		return stats;
+	}
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <random>
+
+#include <uboost2/tree/builder/builder.h>
+#include <uboost2/tree/column_proposer.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/tree/goss.h>
+#include <uboost2/parallel.h>
+#include <uboost2/profiling.h>
+
+
+template <typename X = double>
+class GHHistLayerWiseTreeBuilder : public TreeBuilder {
+	Dataset<X> data;
+	BinMatrix bins;
+	size_t nrows, ncols;
+	double v_mean;
+	std::vector<int> position;
+	std::vector<size_t> nodes;
+	//
+	size_t min_samples_leaf = 1, min_samples_split = 2;
+	double min_weight_leaf = 0.0, min_weight_split = 0.0;
+	double colsample_bytree = 1.0, colsample_bylevel = 1.0;
+	double reg_lambda = 1.0, reg_alpha = -INFINITY;
+	double top_rate = 1.0, other_rate = 0.0;
+	DColumn<> sample_w;
+	std::default_random_engine generator;
+	unsigned seed = 0;
+	int n_threads = 1;
+	profiling::BuilderStats stats;
+protected:
+	// row weights of the current tree: the dataset ones, or the GOSS ones when sampling
+	const double* weights() const {
+		return goss::enabled(top_rate, other_rate) ? sample_w.data() : data.get_w().data();
+	}
+	void init(Tree& tree) {
+		position.clear();
+		position.resize(nrows, trees::ROOTID);
+		if (goss::enabled(top_rate, other_rate))
+			goss::sample(data.get_g(), data.get_w(), top_rate, other_rate, generator, position, sample_w);
+		const double* g = data.get_g().data();
+		const double* h = data.get_h().data();
+		const double* w = weights();
+		double G = 0.0, H = 0.0;
+		for (size_t i = 0; i < nrows; i++) {
+			// rows of weight 0 (out of the subsample) never enter the histograms
+			if (w[i] <= 0.0) position[i] = -1;
+			if (position[i] < 0) continue;
+			G += g[i] * w[i];
+			H += h[i] * w[i];
+		}
+		v_mean = G / (reg_lambda + H);
+		tree[trees::ROOTID].value = v_mean;
+		nodes.clear();
+		nodes.reserve(100);
+		nodes.push_back(trees::ROOTID);
+	}
+	bool is_kept(size_t n, double weight) const {
+		return n >= this->min_samples_split && weight >= min_weight_split;
+	}
+public:
+	GHHistLayerWiseTreeBuilder(
+		const DMatrix<X>& x, const DColumn<double>& g, const DColumn<>& h,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0, size_t max_bins = MAX_BINS,
+		double top_rate = 1.0, double other_rate = 0.0, unsigned seed = 0, int n_threads = 1) : GHHistLayerWiseTreeBuilder(
+			Dataset<X>(x, n_threads), min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+			colsample_bytree, colsample_bylevel, reg_lambda, reg_alpha, max_bins, top_rate, other_rate, seed, n_threads) {
+		data.set_g(g);
+		data.set_h(h);
+	}
+	GHHistLayerWiseTreeBuilder(
+		const Dataset<X>& data,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0, size_t max_bins = MAX_BINS,
+		double top_rate = 1.0, double other_rate = 0.0, unsigned seed = 0, int n_threads = 1) :
+		data{ data }, bins{ this->data.get_bins(max_bins) }, sample_w{ data.nrows(), 0.0 }, generator{ seed } {
+		nrows = data.nrows();
+		ncols = data.ncols();
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_samples_split = min_samples_split;
+		this->min_weight_leaf = min_weight_leaf;
+		this->min_weight_split = min_weight_split;
+		this->colsample_bytree = colsample_bytree;
+		this->colsample_bylevel = colsample_bylevel;
+		this->reg_lambda = reg_lambda;
+		this->reg_alpha = reg_alpha;
+		this->top_rate = top_rate;
+		this->other_rate = other_rate;
+		this->seed = seed;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
+	}
+	//
+	void update(Tree& tree) override {
+		assert(tree[trees::ROOTID].is_leaf);
+		stats.clear();
+		PROFILE_SCOPE(stats, "total");
+
+		ColumnProposer column_proposer(ncols, colsample_bytree, colsample_bylevel, seed);
+
+		std::vector<Split> best_splits;
+		best_splits.resize(trees::max_idx_at_depth(tree.get_max_depth()), Split::build_unsuccessful_split(reg_alpha));
+		std::vector<GHHistSplitter> splitters;
+		splitters.resize(trees::max_idx_at_depth(tree.get_max_depth()), GHHistSplitter(this->min_samples_leaf, this->min_weight_leaf, this->reg_lambda));
+		// one histogram of all the bins of all the columns per node of the current level
+		std::vector<int> slot(trees::max_idx_at_depth(tree.get_max_depth()), -1);
+		std::vector<GHBin> histograms, parent_histograms;
+		std::vector<uint32_t> rows;
+		const size_t total_bins = bins.get_total_bins();
+
+		PROFILE_START(stats, init_timer, "init");
+		init(tree);
+		PROFILE_STOP(init_timer);
+		for (size_t curr_depth = 0; curr_depth < tree.get_max_depth(); curr_depth++) {
+			if (nodes.size() == 0) break;
+			const auto columns = column_proposer.get_columns();
+
+			const DMatrix<X>& x = data.get_x();
+			const double* g = data.get_g().data();
+			const double* h = data.get_h().data();
+			const double* w = weights();
+
+			// build histograms
+			PROFILE_START(stats, hist_timer, "histograms");
+			// when both children of a node reach this level only the smaller one is scanned,
+			// the other one is the parent histogram minus its sibling (needs the same columns at every level)
+			for (size_t k = 0; k < nodes.size(); k++) slot[nodes[k]] = k;
+			std::swap(histograms, parent_histograms);
+			histograms.assign(nodes.size() * total_bins, GHBin());
+			std::vector<char> derived(nodes.size(), 0);
+			if (curr_depth > 0 && colsample_bylevel >= 1.0) {
+				for (size_t k = 0; k < nodes.size(); k++) {
+					const size_t nid = nodes[k], sib = trees::sibling(nid);
+					if (slot[sib] < 0) continue;
+					derived[k] = tree[nid].n > tree[sib].n || (tree[nid].n == tree[sib].n && nid == trees::right_child(trees::parent(nid)));
+				}
+			}
+			// rows to scan, gathered once for all the columns
+			rows.clear();
+			for (size_t i = 0; i < nrows; i++) {
+				const int& nid = position[i];
+				if (nid < 0) continue;
+				const int& s = slot[nid];
+				if (s < 0 || derived[s]) continue;
+				rows.push_back((uint32_t)i);
+			}
+			#pragma omp parallel for num_threads(n_threads)
+			for (int k = 0; k < (int)columns.size(); k++) {
+				const size_t col = columns[k];
+				const size_t offset = bins.get_offset(col);
+				const uint8_t* bcol = bins.column_data(col);
+				for (const uint32_t i : rows) {
+					histograms[slot[position[i]] * total_bins + offset + bcol[i]].add(g[i], h[i], w[i]);
+				}
+				for (size_t s = 0; s < nodes.size(); s++) {
+					if (!derived[s]) continue;
+					const GHBin* parent = &parent_histograms[slot[trees::parent(nodes[s])] * total_bins + offset];
+					const GHBin* sibling = &histograms[slot[trees::sibling(nodes[s])] * total_bins + offset];
+					GHBin* hist = &histograms[s * total_bins + offset];
+					for (size_t b = 0; b < bins.get_n_bins(col); b++) hist[b] = sibling[b].complement(parent[b]);
+				}
+			}
+			PROFILE_STOP(hist_timer);
+			PROFILE_COUNT(stats, rows_scanned, curr_depth, rows.size() * columns.size());
+
+			// node totals
+			for (size_t nid : nodes) {
+				const GHBin* hist = &histograms[slot[nid] * total_bins];
+				const size_t col0 = columns[0];
+				for (size_t b = 0; b < bins.get_n_bins(col0); b++) {
+					splitters[nid].add(hist[bins.get_offset(col0) + b]);
+				}
+			}
+
+			// search splits
+			// columns are split statically among the threads, each one with its own splitters and
+			// best splits, merged in thread order: the result does not depend on the number of threads
+			PROFILE_ONLY(std::vector<size_t> thread_candidates(n_threads, 0);)
+			std::vector<std::vector<Split>> thread_best_splits(n_threads);
+			PROFILE_START(stats, scan_timer, "split_scan");
+			#pragma omp parallel num_threads(n_threads)
+			{
+				PROFILE_ONLY(size_t local_candidates = 0;)
+				std::vector<GHHistSplitter> local_splitters;
+				std::vector<Split>& local_best_splits = thread_best_splits[parallel::thread_id()];
+				for (size_t nid : nodes) {
+					local_splitters.push_back(splitters[nid]);
+					local_best_splits.push_back(best_splits[nid]);
+				}
+				#pragma omp for schedule(static)
+				for (int k = 0; k < (int)columns.size(); k++) {
+					const size_t col = columns[k];
+					const size_t offset = bins.get_offset(col);
+					const size_t missing_bin = bins.get_missing_bin(col);
+					for (size_t s = 0; s < nodes.size(); s++) {
+						const GHBin* hist = &histograms[s * total_bins + offset];
+						// the present bins are scanned with the missing one on the right, then on the left
+						local_splitters[s].start_splitting(col);
+						for (size_t b = 0; b < missing_bin; b++) {
+							const auto candidate_split = local_splitters[s].build_split(hist[b], bins.get_threshold(col, b));
+							if (!candidate_split.succesful) continue;
+							PROFILE_ONLY(local_candidates++;)
+							if (candidate_split > local_best_splits[s]) local_best_splits[s] = candidate_split;
+						}
+						if (hist[missing_bin].n == 0) continue;
+						local_splitters[s].start_splitting(col, hist[missing_bin]);
+						for (size_t b = 0; b < missing_bin; b++) {
+							const auto candidate_split = local_splitters[s].build_split(hist[b], bins.get_threshold(col, b));
+							if (!candidate_split.succesful) continue;
+							PROFILE_ONLY(local_candidates++;)
+							if (candidate_split > local_best_splits[s]) local_best_splits[s] = candidate_split;
+						}
+					}
+				}
+				PROFILE_ONLY(thread_candidates[parallel::thread_id()] = local_candidates;)
+			}
+			for (const auto& local_best_splits : thread_best_splits) {
+				for (size_t k = 0; k < local_best_splits.size(); k++) {
+					if (local_best_splits[k] > best_splits[nodes[k]]) best_splits[nodes[k]] = local_best_splits[k];
+				}
+			}
+			PROFILE_STOP(scan_timer);
+			PROFILE_ONLY(for (size_t n : thread_candidates) PROFILE_COUNT(stats, candidate_splits, curr_depth, n);)
+
+			// update position
+			PROFILE_START(stats, position_timer, "partition");
+			#pragma omp parallel for num_threads(n_threads)
+			for (int i = 0; i < (int)nrows; i++) {
+				int nid = position[i];
+				if (nid < 0) continue;
+				const Split& split = best_splits[nid];
+				if (!split.succesful) {
+					position[i] = -1;
+					continue;
+				}
+				const double xi = x(i, split.column);
+				if (is_missing(xi) ? !split.default_left : xi >= split.threshold) {
+					if (is_kept(split.r_n, split.r_w)) position[i] = trees::right_child(nid);
+					else position[i] = -1;
+				}
+				else {
+					if (is_kept(split.l_n, split.l_w)) position[i] = trees::left_child(nid);
+					else position[i] = -1;
+				}
+			}
+			PROFILE_STOP(position_timer);
+
+			// update tree
+			PROFILE_START(stats, update_timer, "tree_update");
+			for (auto nid : nodes) {
+				const Split& split = best_splits[nid];
+				if (split.succesful) {
+					PROFILE_COUNT(stats, nodes_expanded, curr_depth, 1);
+					tree[nid].is_leaf = false;
+					tree[nid].column = split.column;
+					tree[nid].threshold = split.threshold;
+					tree[nid].default_left = split.default_left;
+					tree[nid].value = split.p_value;
+					tree[nid].criterion = split.p_criterion;
+					tree[nid].gain = split.criterion_gain;
+					tree[nid].n = split.p_n;
+
+					size_t lchild = trees::left_child(nid);
+					size_t rchild = trees::right_child(nid);
+
+					tree.init_node_as_leaf(lchild);
+					tree[lchild].value = split.l_value;
+					tree[lchild].criterion = split.l_criterion;
+					tree[lchild].n = split.l_n;
+
+					tree.init_node_as_leaf(rchild);
+					tree[rchild].value = split.r_value;
+					tree[rchild].criterion = split.r_criterion;
+					tree[rchild].n = split.r_n;
+				}
+			}
+			PROFILE_STOP(update_timer);
+
+			// update nodes
+			std::vector<size_t> nodes_old(nodes);
+			nodes.clear();
+			for (auto parent : nodes_old) {
+				const Split& split = best_splits[parent];
+				if (split.succesful) {
+					if (is_kept(split.r_n, split.r_w))
+						nodes.push_back(trees::right_child(parent));
+					if (is_kept(split.l_n, split.l_w))
+						nodes.push_back(trees::left_child(parent));
+				}
+			}
+		}
+
+	}
+	//
+	const profiling::BuilderStats& get_stats() const {
+		return stats;
+	}
+};
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <uboost2/tree/builder/builder.h>
+#include <uboost2/tree/column_proposer.h>
+#include <uboost2/tree/paged_dataset.h>
+#include <uboost2/parallel.h>
+#include <uboost2/profiling.h>
+
+
+// GHHistLayerWiseTreeBuilder over a paged file: the bin codes are streamed from disk once per level,
+// through n_buffers page buffers filled ahead by a background thread
+// the pass of a level first moves the rows of the page down the splits of the previous level, then
+// adds them to the histograms of this one, so a tree of depth d reads the file d times
+// memory: the page buffers, the histograms, and per row the position and g, h, w
+class GHPagedLayerWiseTreeBuilder : public TreeBuilder {
+	const PagedDataset& data;
+	DColumn<> g, h, w;
+	size_t nrows, ncols;
+	double v_mean;
+	std::vector<int> position;
+	std::vector<size_t> nodes;
+	//
+	size_t min_samples_leaf = 1, min_samples_split = 2;
+	double min_weight_leaf = 0.0, min_weight_split = 0.0;
+	double colsample_bytree = 1.0, colsample_bylevel = 1.0;
+	double reg_lambda = 1.0, reg_alpha = -INFINITY;
+	unsigned seed = 0;
+	size_t n_buffers = 2;
+	int n_threads = 1;
+	profiling::BuilderStats stats;
+protected:
+	void init(Tree& tree) {
+		position.clear();
+		position.resize(nrows, trees::ROOTID);
+		double G = 0.0, H = 0.0;
+		for (size_t i = 0; i < nrows; i++) {
+			// rows of weight 0 (out of the subsample) never enter the histograms
+			if (w(i) <= 0.0) {
+				position[i] = -1;
+				continue;
+			}
+			G += g(i) * w(i);
+			H += h(i) * w(i);
+		}
+		v_mean = G / (reg_lambda + H);
+		tree[trees::ROOTID].value = v_mean;
+		nodes.clear();
+		nodes.reserve(100);
+		nodes.push_back(trees::ROOTID);
+	}
+	// the rows of a page at a node of the previous level go to its children, or leave the tree
+	void update_position(const PageStream::Page& page, const std::vector<Split>& best_splits, const std::vector<size_t>& split_bins) {
+		#pragma omp parallel for num_threads(n_threads)
+		for (int r = 0; r < (int)page.nrows; r++) {
+			const size_t i = page.first_row + r;
+			const int nid = position[i];
+			if (nid < 0) continue;
+			const Split& split = best_splits[nid];
+			if (!split.succesful) {
+				position[i] = -1;
+				continue;
+			}
+			const size_t code = page.column(split.column)[r];
+			if (code == data.get_missing_bin(split.column) ? !split.default_left : code >= split_bins[nid]) {
+				if (is_kept(split.r_n, split.r_w)) position[i] = trees::right_child(nid);
+				else position[i] = -1;
+			}
+			else {
+				if (is_kept(split.l_n, split.l_w)) position[i] = trees::left_child(nid);
+				else position[i] = -1;
+			}
+		}
+	}
+	bool is_kept(size_t n, double weight) const {
+		return n >= this->min_samples_split && weight >= min_weight_split;
+	}
+public:
+	GHPagedLayerWiseTreeBuilder(
+		const PagedDataset& data, const DColumn<>& g, const DColumn<>& h, const DColumn<>& w,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0, unsigned seed = 0, size_t n_buffers = 2, int n_threads = 1) :
+		data{ data }, g{ g }, h{ h }, w{ w } {
+		assert(g.nrows() == data.nrows() && h.nrows() == data.nrows() && w.nrows() == data.nrows());
+		nrows = data.nrows();
+		ncols = data.ncols();
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_samples_split = min_samples_split;
+		this->min_weight_leaf = min_weight_leaf;
+		this->min_weight_split = min_weight_split;
+		this->colsample_bytree = colsample_bytree;
+		this->colsample_bylevel = colsample_bylevel;
+		this->reg_lambda = reg_lambda;
+		this->reg_alpha = reg_alpha;
+		this->seed = seed;
+		this->n_buffers = n_buffers;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
+	}
+	//
+	void update(Tree& tree) override {
+		assert(tree[trees::ROOTID].is_leaf);
+		stats.clear();
+		PROFILE_SCOPE(stats, "total");
+
+		ColumnProposer column_proposer(ncols, colsample_bytree, colsample_bylevel, seed);
+
+		std::vector<Split> best_splits;
+		best_splits.resize(trees::max_idx_at_depth(tree.get_max_depth()), Split::build_unsuccessful_split(reg_alpha));
+		// first bin on the right of the split of every node
+		std::vector<size_t> split_bins(trees::max_idx_at_depth(tree.get_max_depth()), 0);
+		std::vector<GHHistSplitter> splitters;
+		splitters.resize(trees::max_idx_at_depth(tree.get_max_depth()), GHHistSplitter(this->min_samples_leaf, this->min_weight_leaf, this->reg_lambda));
+		// one histogram of all the bins of all the columns per node of the current level
+		std::vector<int> slot(trees::max_idx_at_depth(tree.get_max_depth()), -1);
+		std::vector<GHBin> histograms, parent_histograms;
+		std::vector<uint32_t> rows;
+		const size_t total_bins = data.get_total_bins();
+
+		PROFILE_START(stats, init_timer, "init");
+		init(tree);
+		PROFILE_STOP(init_timer);
+		for (size_t curr_depth = 0; curr_depth < tree.get_max_depth(); curr_depth++) {
+			if (nodes.size() == 0) break;
+			const auto columns = column_proposer.get_columns();
+
+			// the pass over the pages: positions, then histograms
+			PROFILE_START(stats, hist_timer, "histograms");
+			// when both children of a node reach this level only the smaller one is scanned,
+			// the other one is the parent histogram minus its sibling (needs the same columns at every level)
+			for (size_t k = 0; k < nodes.size(); k++) slot[nodes[k]] = k;
+			std::swap(histograms, parent_histograms);
+			histograms.assign(nodes.size() * total_bins, GHBin());
+			std::vector<char> derived(nodes.size(), 0);
+			if (curr_depth > 0 && colsample_bylevel >= 1.0) {
+				for (size_t k = 0; k < nodes.size(); k++) {
+					const size_t nid = nodes[k], sib = trees::sibling(nid);
+					if (slot[sib] < 0) continue;
+					derived[k] = tree[nid].n > tree[sib].n || (tree[nid].n == tree[sib].n && nid == trees::right_child(trees::parent(nid)));
+				}
+			}
+			PageStream stream(data, n_buffers);
+			PageStream::Page page;
+			while (true) {
+				PROFILE_START(stats, wait_timer, "io_wait");
+				const bool more = stream.next(page);
+				PROFILE_STOP(wait_timer);
+				if (!more) break;
+				if (curr_depth > 0) update_position(page, best_splits, split_bins);
+				rows.clear();
+				for (size_t r = 0; r < page.nrows; r++) {
+					const int& nid = position[page.first_row + r];
+					if (nid < 0) continue;
+					const int& s = slot[nid];
+					if (s < 0 || derived[s]) continue;
+					rows.push_back((uint32_t)r);
+				}
+				PROFILE_COUNT(stats, rows_scanned, curr_depth, rows.size() * columns.size());
+				const double* gp = g.data() + page.first_row;
+				const double* hp = h.data() + page.first_row;
+				const double* wp = w.data() + page.first_row;
+				const int* pp = position.data() + page.first_row;
+				#pragma omp parallel for num_threads(n_threads)
+				for (int k = 0; k < (int)columns.size(); k++) {
+					const size_t col = columns[k];
+					const size_t offset = data.get_offset(col);
+					const uint8_t* bcol = page.column(col);
+					for (const uint32_t r : rows) {
+						histograms[slot[pp[r]] * total_bins + offset + bcol[r]].add(gp[r], hp[r], wp[r]);
+					}
+				}
+			}
+			#pragma omp parallel for num_threads(n_threads)
+			for (int k = 0; k < (int)columns.size(); k++) {
+				const size_t col = columns[k];
+				const size_t offset = data.get_offset(col);
+				for (size_t s = 0; s < nodes.size(); s++) {
+					if (!derived[s]) continue;
+					const GHBin* parent = &parent_histograms[slot[trees::parent(nodes[s])] * total_bins + offset];
+					const GHBin* sibling = &histograms[slot[trees::sibling(nodes[s])] * total_bins + offset];
+					GHBin* hist = &histograms[s * total_bins + offset];
+					for (size_t b = 0; b < data.get_n_bins(col); b++) hist[b] = sibling[b].complement(parent[b]);
+				}
+			}
+			PROFILE_STOP(hist_timer);
+
+			// node totals
+			for (size_t nid : nodes) {
+				const GHBin* hist = &histograms[slot[nid] * total_bins];
+				const size_t col0 = columns[0];
+				for (size_t b = 0; b < data.get_n_bins(col0); b++) {
+					splitters[nid].add(hist[data.get_offset(col0) + b]);
+				}
+			}
+
+			// search splits
+			// columns are split statically among the threads, each one with its own splitters and
+			// best splits, merged in thread order: the result does not depend on the number of threads
+			PROFILE_ONLY(std::vector<size_t> thread_candidates(n_threads, 0);)
+			std::vector<std::vector<Split>> thread_best_splits(n_threads);
+			PROFILE_START(stats, scan_timer, "split_scan");
+			#pragma omp parallel num_threads(n_threads)
+			{
+				PROFILE_ONLY(size_t local_candidates = 0;)
+				std::vector<GHHistSplitter> local_splitters;
+				std::vector<Split>& local_best_splits = thread_best_splits[parallel::thread_id()];
+				for (size_t nid : nodes) {
+					local_splitters.push_back(splitters[nid]);
+					local_best_splits.push_back(best_splits[nid]);
+				}
+				#pragma omp for schedule(static)
+				for (int k = 0; k < (int)columns.size(); k++) {
+					const size_t col = columns[k];
+					const size_t offset = data.get_offset(col);
+					const size_t missing_bin = data.get_missing_bin(col);
+					for (size_t s = 0; s < nodes.size(); s++) {
+						const GHBin* hist = &histograms[s * total_bins + offset];
+						// the present bins are scanned with the missing one on the right, then on the left
+						local_splitters[s].start_splitting(col);
+						for (size_t b = 0; b < missing_bin; b++) {
+							const auto candidate_split = local_splitters[s].build_split(hist[b], data.get_threshold(col, b));
+							if (!candidate_split.succesful) continue;
+							PROFILE_ONLY(local_candidates++;)
+							if (candidate_split > local_best_splits[s]) local_best_splits[s] = candidate_split;
+						}
+						if (hist[missing_bin].n == 0) continue;
+						local_splitters[s].start_splitting(col, hist[missing_bin]);
+						for (size_t b = 0; b < missing_bin; b++) {
+							const auto candidate_split = local_splitters[s].build_split(hist[b], data.get_threshold(col, b));
+							if (!candidate_split.succesful) continue;
+							PROFILE_ONLY(local_candidates++;)
+							if (candidate_split > local_best_splits[s]) local_best_splits[s] = candidate_split;
+						}
+					}
+				}
+				PROFILE_ONLY(thread_candidates[parallel::thread_id()] = local_candidates;)
+			}
+			for (const auto& local_best_splits : thread_best_splits) {
+				for (size_t k = 0; k < local_best_splits.size(); k++) {
+					if (local_best_splits[k] > best_splits[nodes[k]]) best_splits[nodes[k]] = local_best_splits[k];
+				}
+			}
+			PROFILE_STOP(scan_timer);
+			PROFILE_ONLY(for (size_t n : thread_candidates) PROFILE_COUNT(stats, candidate_splits, curr_depth, n);)
+
+			// update tree; the rows follow the splits in the pass of the next level
+			PROFILE_START(stats, update_timer, "tree_update");
+			for (auto nid : nodes) {
+				const Split& split = best_splits[nid];
+				if (split.succesful) {
+					PROFILE_COUNT(stats, nodes_expanded, curr_depth, 1);
+					split_bins[nid] = data.get_split_bin(split.column, split.threshold);
+					tree[nid].is_leaf = false;
+					tree[nid].column = split.column;
+					tree[nid].threshold = split.threshold;
+					tree[nid].default_left = split.default_left;
+					tree[nid].value = split.p_value;
+					tree[nid].criterion = split.p_criterion;
+					tree[nid].gain = split.criterion_gain;
+					tree[nid].n = split.p_n;
+
+					size_t lchild = trees::left_child(nid);
+					size_t rchild = trees::right_child(nid);
+
+					tree.init_node_as_leaf(lchild);
+					tree[lchild].value = split.l_value;
+					tree[lchild].criterion = split.l_criterion;
+					tree[lchild].n = split.l_n;
+
+					tree.init_node_as_leaf(rchild);
+					tree[rchild].value = split.r_value;
+					tree[rchild].criterion = split.r_criterion;
+					tree[rchild].n = split.r_n;
+				}
+			}
+			PROFILE_STOP(update_timer);
+
+			// update nodes
+			std::vector<size_t> nodes_old(nodes);
+			nodes.clear();
+			for (auto parent : nodes_old) {
+				const Split& split = best_splits[parent];
+				if (split.succesful) {
+					if (is_kept(split.r_n, split.r_w))
+						nodes.push_back(trees::right_child(parent));
+					if (is_kept(split.l_n, split.l_w))
+						nodes.push_back(trees::left_child(parent));
+				}
+			}
+		}
+
+	}
+	//
+	const profiling::BuilderStats& get_stats() const {
+		return stats;
+	}
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include <uboost2/sparse.h>
+#include <uboost2/tree/builder/builder.h>
+#include <uboost2/tree/column_proposer.h>
+#include <uboost2/parallel.h>
+
+// layer-wise GH builder on column-compressed input, the cost of a level is O(nrows + nnz)
+// only the stored entries are scanned; the rows without one in a column form the default bucket,
+// which every candidate sends to the side with the larger gain (scanned once with it on the right,
+// once with it on the left)
+class GHSparseLayerWiseTreeBuilder : public TreeBuilder {
+	CSCMatrix<> x;
+	DColumn<> g, h, w;
+	size_t nrows, ncols;
+	// stored entries of every column sorted by value: same layout as the CSC arrays
+	std::vector<uint32_t> sorted_rows;
+	std::vector<double> sorted_values;
+	std::vector<int> position, next_position;
+	std::vector<size_t> nodes;
+	//
+	size_t min_samples_leaf = 1, min_samples_split = 2;
+	double min_weight_leaf = 0.0, min_weight_split = 0.0;
+	double colsample_bytree = 1.0, colsample_bylevel = 1.0;
+	double reg_lambda = 1.0, reg_alpha = 0.0;
+	unsigned seed = 0;
+	int n_threads = 1;
+protected:
+	void sort_columns() {
+		sorted_rows.resize(x.nnz());
+		sorted_values.resize(x.nnz());
+		#pragma omp parallel num_threads(n_threads)
+		{
+			std::vector<uint32_t> perm;
+			#pragma omp for schedule(dynamic)
+			for (int col = 0; col < (int)ncols; col++) {
+				const size_t n = x.column_size(col), offset = x.indptr()[col];
+				const uint32_t* rows = x.row_data(col);
+				const double* values = x.column_data(col);
+				perm.resize(n);
+				std::iota(perm.begin(), perm.end(), 0);
+				std::stable_sort(perm.begin(), perm.end(), [&](uint32_t a, uint32_t b) { return values[a] < values[b]; });
+				for (size_t k = 0; k < n; k++) {
+					sorted_rows[offset + k] = rows[perm[k]];
+					sorted_values[offset + k] = values[perm[k]];
+				}
+			}
+		}
+	}
+	bool is_kept(size_t n, double weight) const {
+		return n >= this->min_samples_split && weight >= min_weight_split;
+	}
+	// child of nid for a row, -1 when the child will not be split
+	inline int child_of(const Split& split, size_t nid, bool left) const {
+		if (left) return is_kept(split.l_n, split.l_w) ? (int)trees::left_child(nid) : -1;
+		return is_kept(split.r_n, split.r_w) ? (int)trees::right_child(nid) : -1;
+	}
+	void init(Tree& tree) {
+		position.assign(nrows, trees::ROOTID);
+		next_position.resize(nrows);
+		double G = 0.0, H = 0.0;
+		for (size_t i = 0; i < nrows; i++) {
+			// rows of weight 0 never enter the tree
+			if (w(i) <= 0.0) position[i] = -1;
+			G += g(i) * w(i);
+			H += h(i) * w(i);
+		}
+		tree[trees::ROOTID].value = G / (reg_lambda + H);
+		nodes.clear();
+		nodes.push_back(trees::ROOTID);
+	}
+public:
+	GHSparseLayerWiseTreeBuilder(
+		const CSCMatrix<>& x, const DColumn<>& g, const DColumn<>& h,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0, unsigned seed = 0, int n_threads = 1) : GHSparseLayerWiseTreeBuilder(
+			x, g, h, DColumn<>(x.nrows(), 1.0), min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+			colsample_bytree, colsample_bylevel, reg_lambda, reg_alpha, seed, n_threads) {
+	}
+	GHSparseLayerWiseTreeBuilder(
+		const CSCMatrix<>& x, const DColumn<>& g, const DColumn<>& h, const DColumn<>& w,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0, unsigned seed = 0, int n_threads = 1) :
+		x{ x }, g{ g }, h{ h }, w{ w } {
+		assert(g.nrows() == x.nrows() && h.nrows() == x.nrows() && w.nrows() == x.nrows());
+		nrows = x.nrows();
+		ncols = x.ncols();
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_samples_split = min_samples_split;
+		this->min_weight_leaf = min_weight_leaf;
+		this->min_weight_split = min_weight_split;
+		this->colsample_bytree = colsample_bytree;
+		this->colsample_bylevel = colsample_bylevel;
+		this->reg_lambda = reg_lambda;
+		this->reg_alpha = reg_alpha;
+		this->seed = seed;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
+		sort_columns();
+	}
+	//
+	void update(Tree& tree) override {
+		assert(tree[trees::ROOTID].is_leaf);
+
+		ColumnProposer column_proposer(ncols, colsample_bytree, colsample_bylevel, seed);
+		std::vector<Split> best_splits(trees::max_idx_at_depth(tree.get_max_depth()), Split::build_unsuccessful_split(reg_alpha));
+		std::vector<int> slot(trees::max_idx_at_depth(tree.get_max_depth()) + 1, -1);
+		const double* gp = g.data();
+		const double* hp = h.data();
+		const double* wp = w.data();
+
+		init(tree);
+		for (size_t curr_depth = 0; curr_depth < tree.get_max_depth(); curr_depth++) {
+			if (nodes.size() == 0) break;
+			for (size_t k = 0; k < nodes.size(); k++) slot[nodes[k]] = k;
+			std::vector<GHSplitter> splitters(nodes.size(), GHSplitter(this->min_samples_leaf, this->min_weight_leaf, this->reg_lambda));
+			for (size_t i = 0; i < nrows; i++) {
+				if (position[i] >= 0) splitters[slot[position[i]]].add(gp[i], hp[i], wp[i]);
+			}
+
+			// search splits, two scans of the stored entries per column: default bucket right, then left
+			// columns are split statically among the threads and merged in thread order,
+			// the result does not depend on the number of threads
+			const auto columns = column_proposer.get_columns();
+			std::vector<std::vector<Split>> thread_best_splits(n_threads);
+			#pragma omp parallel num_threads(n_threads)
+			{
+				std::vector<GHSplitter> local_splitters(splitters);
+				std::vector<char> has_defaults(nodes.size());
+				std::vector<Split>& local_best_splits = thread_best_splits[parallel::thread_id()];
+				for (size_t nid : nodes) local_best_splits.push_back(best_splits[nid]);
+				#pragma omp for schedule(static)
+				for (int c = 0; c < (int)columns.size(); c++) {
+					const size_t col = columns[c];
+					const size_t begin = x.indptr()[col], end = x.indptr()[col + 1];
+					for (auto& splitter : local_splitters) splitter.start_splitting(col);
+					for (size_t q = begin; q < end; q++) {
+						const uint32_t i = sorted_rows[q];
+						const int nid = position[i];
+						if (nid < 0) continue;
+						const int s = slot[nid];
+						const auto candidate_split = local_splitters[s].build_split(i, sorted_values[q], gp[i], hp[i], wp[i]);
+						if (candidate_split.succesful && candidate_split > local_best_splits[s]) local_best_splits[s] = candidate_split;
+					}
+					for (size_t k = 0; k < nodes.size(); k++) {
+						const GHBin defaults = local_splitters[k].left_stats().complement(local_splitters[k].total_stats());
+						has_defaults[k] = defaults.n > 0;
+						if (has_defaults[k]) local_splitters[k].start_splitting(col, defaults);
+					}
+					for (size_t q = begin; q < end; q++) {
+						const uint32_t i = sorted_rows[q];
+						const int nid = position[i];
+						if (nid < 0) continue;
+						const int s = slot[nid];
+						if (!has_defaults[s]) continue;
+						const auto candidate_split = local_splitters[s].build_split(i, sorted_values[q], gp[i], hp[i], wp[i]);
+						if (candidate_split.succesful && candidate_split > local_best_splits[s]) local_best_splits[s] = candidate_split;
+					}
+				}
+			}
+			for (const auto& local_best_splits : thread_best_splits) {
+				for (size_t k = 0; k < local_best_splits.size(); k++) {
+					if (local_best_splits[k] > best_splits[nodes[k]]) best_splits[nodes[k]] = local_best_splits[k];
+				}
+			}
+
+			// update position: every row follows the default direction of its node,
+			// then the stored entries of the split columns are sent by their value
+			#pragma omp parallel for num_threads(n_threads)
+			for (int i = 0; i < (int)nrows; i++) {
+				const int nid = position[i];
+				if (nid < 0 || !best_splits[nid].succesful) {
+					next_position[i] = -1;
+					continue;
+				}
+				next_position[i] = child_of(best_splits[nid], nid, best_splits[nid].default_left);
+			}
+			std::vector<size_t> split_columns;
+			for (size_t nid : nodes) {
+				if (best_splits[nid].succesful) split_columns.push_back(best_splits[nid].column);
+			}
+			std::sort(split_columns.begin(), split_columns.end());
+			split_columns.erase(std::unique(split_columns.begin(), split_columns.end()), split_columns.end());
+			// a row is moved by the column of its own node only, so the columns never write the same row
+			#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+			for (int c = 0; c < (int)split_columns.size(); c++) {
+				const size_t col = split_columns[c];
+				const uint32_t* rows = x.row_data(col);
+				const double* values = x.column_data(col);
+				for (size_t k = 0; k < x.column_size(col); k++) {
+					const uint32_t i = rows[k];
+					const int nid = position[i];
+					if (nid < 0) continue;
+					const Split& split = best_splits[nid];
+					if (!split.succesful || split.column != col) continue;
+					next_position[i] = child_of(split, nid, values[k] < split.threshold);
+				}
+			}
+			std::swap(position, next_position);
+
+			// update tree
+			for (auto nid : nodes) {
+				const Split& split = best_splits[nid];
+				if (split.succesful) {
+					tree[nid].is_leaf = false;
+					tree[nid].column = split.column;
+					tree[nid].threshold = split.threshold;
+					tree[nid].default_left = split.default_left;
+					tree[nid].value = split.p_value;
+					tree[nid].criterion = split.p_criterion;
+					tree[nid].gain = split.criterion_gain;
+					tree[nid].n = split.p_n;
+
+					size_t lchild = trees::left_child(nid);
+					size_t rchild = trees::right_child(nid);
+
+					tree.init_node_as_leaf(lchild);
+					tree[lchild].value = split.l_value;
+					tree[lchild].criterion = split.l_criterion;
+					tree[lchild].n = split.l_n;
+
+					tree.init_node_as_leaf(rchild);
+					tree[rchild].value = split.r_value;
+					tree[rchild].criterion = split.r_criterion;
+					tree[rchild].n = split.r_n;
+				}
+			}
+
+			// update nodes
+			std::vector<size_t> nodes_old(nodes);
+			nodes.clear();
+			for (auto parent : nodes_old) {
+				const Split& split = best_splits[parent];
+				if (split.succesful) {
+					if (is_kept(split.r_n, split.r_w)) nodes.push_back(trees::right_child(parent));
+					if (is_kept(split.l_n, split.l_w)) nodes.push_back(trees::left_child(parent));
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <random>
+
+#include <uboost2/tree/builder/builder.h>
+#include <uboost2/tree/column_proposer.h>
+#include <uboost2/tree/node_proposer.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/parallel.h>
+
+// best-first growth: the leaf whose best split has the largest gain is expanded first
+// the rows of a leaf are kept contiguous in every column of a private copy of the sorted index,
+// so evaluating a leaf only touches its own rows
+template <typename X = double>
+class GHLeafWiseTreeBuilder : public NodeWiseTreeBuilder {
+	Dataset<X> data;
+	DMatrix<uint32_t> order;
+	ColumnProposer column_proposer;
+	size_t nrows, ncols;
+	//
+	struct range {
+		size_t start;
+		size_t end;
+	};
+	std::vector<range> ranges;
+	std::vector<Split> splits;
+	std::vector<char> goes_left;
+	//
+	size_t min_samples_leaf = 1, min_samples_split = 2;
+	double min_weight_leaf = 0.0, min_weight_split = 0.0;
+	double reg_lambda = 1.0, reg_alpha = 0.0;
+	int n_threads = 1;
+protected:
+	void init(Tree& tree) override {
+		assert(tree[trees::ROOTID].is_leaf);
+		delete node_proposer;
+		node_proposer = new HigherFirstNodeProposer();
+
+		// rows of weight 0 (out of the subsample) are left out of the copy of the index
+		const SortedIndex& index = data.get_index();
+		const double* w = data.get_w().data();
+		size_t n_live = 0;
+		for (size_t i = 0; i < nrows; i++) n_live += w[i] > 0.0;
+		if (n_live == nrows) std::copy(index.column_data(0), index.column_data(0) + nrows * ncols, order.column_data(0));
+		else {
+			#pragma omp parallel for num_threads(n_threads)
+			for (int col = 0; col < (int)ncols; col++) {
+				const uint32_t* in = index.column_data(col);
+				uint32_t* out = order.column_data(col);
+				for (size_t r = 0; r < nrows; r++) {
+					if (w[in[r]] > 0.0) *out++ = in[r];
+				}
+			}
+		}
+
+		const size_t size = trees::max_idx_at_depth(tree.get_max_depth()) + 1;
+		ranges.assign(size, range{ 0, 0 });
+		splits.assign(size, Split::build_unsuccessful_split(reg_alpha));
+		ranges[trees::ROOTID] = range{ 0, n_live };
+
+		double G = 0.0, H = 0.0;
+		for (size_t i = 0; i < nrows; i++) {
+			G += data.get_g()(i) * w[i];
+			H += data.get_h()(i) * w[i];
+		}
+		tree[trees::ROOTID].value = G / (reg_lambda + H);
+		tree[trees::ROOTID].n = n_live;
+
+		propose(tree, trees::ROOTID);
+	}
+	// finds the best split of a leaf and queues the leaf by its gain
+	void propose(const Tree& tree, size_t nid) {
+		const range& r = ranges[nid];
+		if (r.end - r.start < min_samples_split) return;
+		if (trees::depth_at_idx(nid) >= tree.get_max_depth()) return;
+
+		const double* g = data.get_g().data();
+		const double* h = data.get_h().data();
+		const double* w = data.get_w().data();
+		const DMatrix<X>& x = data.get_x();
+
+		GHSplitter splitter(min_samples_leaf, min_weight_leaf, reg_lambda);
+		const uint32_t* order0 = order.column_data(0);
+		double weight = 0.0;
+		for (size_t k = r.start; k < r.end; k++) {
+			const uint32_t i = order0[k];
+			splitter.add(g[i], h[i], w[i]);
+			weight += w[i];
+		}
+		if (weight < min_weight_split) return;
+
+		// columns are split statically among the threads and merged in thread order,
+		// the result does not depend on the number of threads
+		const auto columns = column_proposer.get_columns();
+		std::vector<Split> thread_best_splits(n_threads, splits[nid]);
+		#pragma omp parallel num_threads(n_threads)
+		{
+			GHSplitter local_splitter(splitter);
+			Split& local_best_split = thread_best_splits[parallel::thread_id()];
+			#pragma omp for schedule(static)
+			for (int k = 0; k < (int)columns.size(); k++) {
+				const size_t col = columns[k];
+				const uint32_t* ocol = order.column_data(col);
+				const X* xcol = x.column_data(col);
+				// the missing values are at the end of the range: scanned with them on the right, then on the left
+				size_t present_end = r.end;
+				GHBin missing;
+				while (present_end > r.start && is_missing(xcol[ocol[present_end - 1]])) {
+					const uint32_t i = ocol[--present_end];
+					missing.add(g[i], h[i], w[i]);
+				}
+				local_splitter.start_splitting(col);
+				for (size_t q = r.start; q < present_end; q++) {
+					const uint32_t i = ocol[q];
+					const auto candidate_split = local_splitter.build_split(i, xcol[i], g[i], h[i], w[i]);
+					if (!candidate_split.succesful) continue;
+					if (candidate_split > local_best_split) local_best_split = candidate_split;
+				}
+				if (missing.n == 0) continue;
+				local_splitter.start_splitting(col, missing);
+				for (size_t q = r.start; q < present_end; q++) {
+					const uint32_t i = ocol[q];
+					const auto candidate_split = local_splitter.build_split(i, xcol[i], g[i], h[i], w[i]);
+					if (!candidate_split.succesful) continue;
+					if (candidate_split > local_best_split) local_best_split = candidate_split;
+				}
+			}
+		}
+		Split& best_split = splits[nid];
+		for (const auto& local_best_split : thread_best_splits) {
+			if (local_best_split > best_split) best_split = local_best_split;
+		}
+		if (best_split.succesful) node_proposer->push(nid, best_split.criterion_gain);
+	}
+	void expand_node(Tree& tree, size_t nid) override {
+		const Split& split = splits[nid];
+		if (!split.succesful) return;
+
+		tree[nid].is_leaf = false;
+		tree[nid].column = split.column;
+		tree[nid].threshold = split.threshold;
+		tree[nid].default_left = split.default_left;
+		tree[nid].value = split.p_value;
+		tree[nid].criterion = split.p_criterion;
+		tree[nid].gain = split.criterion_gain;
+		tree[nid].n = split.p_n;
+
+		size_t lchild = trees::left_child(nid);
+		size_t rchild = trees::right_child(nid);
+
+		tree.init_node_as_leaf(lchild);
+		tree[lchild].value = split.l_value;
+		tree[lchild].criterion = split.l_criterion;
+		tree[lchild].n = split.l_n;
+
+		tree.init_node_as_leaf(rchild);
+		tree[rchild].value = split.r_value;
+		tree[rchild].criterion = split.r_criterion;
+		tree[rchild].n = split.r_n;
+
+		// stable partition of the rows of the node in every column: left rows first, sorted order kept
+		const range r = ranges[nid];
+		const X* xsplit = data.get_x().column_data(split.column);
+		const uint32_t* order0 = order.column_data(0);
+		for (size_t k = r.start; k < r.end; k++) {
+			const uint32_t i = order0[k];
+			goes_left[i] = is_missing(xsplit[i]) ? split.default_left : xsplit[i] < split.threshold;
+		}
+		#pragma omp parallel num_threads(n_threads)
+		{
+			std::vector<uint32_t> buffer;
+			buffer.reserve(r.end - r.start);
+			#pragma omp for schedule(static)
+			for (int col = 0; col < (int)ncols; col++) {
+				uint32_t* ocol = order.column_data(col);
+				size_t l = r.start;
+				buffer.clear();
+				for (size_t k = r.start; k < r.end; k++) {
+					const uint32_t i = ocol[k];
+					if (goes_left[i]) ocol[l++] = i;
+					else buffer.push_back(i);
+				}
+				std::copy(buffer.begin(), buffer.end(), ocol + l);
+			}
+		}
+		ranges[lchild] = range{ r.start, r.start + split.l_n };
+		ranges[rchild] = range{ r.start + split.l_n, r.end };
+
+		propose(tree, lchild);
+		propose(tree, rchild);
+	}
+public:
+	GHLeafWiseTreeBuilder(
+		const DMatrix<X>& x, const DColumn<double>& g, const DColumn<>& h,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0, size_t max_leaves = 31, unsigned seed = 0, int n_threads = 1) : GHLeafWiseTreeBuilder(
+			Dataset<X>(x, n_threads), min_samples_leaf, min_samples_split, min_weight_leaf, min_weight_split,
+			colsample_bytree, colsample_bylevel, reg_lambda, reg_alpha, max_leaves, seed, n_threads) {
+		data.set_g(g);
+		data.set_h(h);
+	}
+	GHLeafWiseTreeBuilder(
+		const Dataset<X>& data,
+		size_t min_samples_leaf = 1, size_t min_samples_split = 2,
+		double min_weight_leaf = 0.0, double min_weight_split = 0.0,
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0,
+		double reg_lambda = 1.0, double reg_alpha = 0.0, size_t max_leaves = 31, unsigned seed = 0, int n_threads = 1) :
+		data{ data }, order{ data.nrows(), data.ncols() }, column_proposer{ data.ncols(), colsample_bytree, colsample_bylevel, seed } {
+		nrows = data.nrows();
+		ncols = data.ncols();
+		goes_left.resize(nrows, 0);
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_samples_split = min_samples_split;
+		this->min_weight_leaf = min_weight_leaf;
+		this->min_weight_split = min_weight_split;
+		this->reg_lambda = reg_lambda;
+		this->reg_alpha = reg_alpha;
+		this->max_leaves = max_leaves;
+		this->n_threads = parallel::resolve_n_threads(n_threads);
+	}
+	~GHLeafWiseTreeBuilder() {
+		delete this->node_proposer;
+	}
+};
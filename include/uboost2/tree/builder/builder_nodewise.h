@@ -4,12 +4,14 @@
 #include <uboost2/tree/node_proposer.h>
 #include <uboost2/tree/column_proposer.h>
 #include <uboost2/tree/entry.h>
+#include <uboost2/tree/sorted_index.h>
 
 class SplitTreeBuilder : public NodeWiseTreeBuilder {
 	const DMatrix<>& x;
 	ColumnProposer *column_proposer;
 	size_t nrows, ncols;
-	EntryMatrix entries;
+	SortedIndex index;
+	DColumn<> y, w;
 	double y_mean;
 	//
 	size_t min_samples_leaf, min_samples_split;
@@ -22,11 +24,10 @@ class SplitTreeBuilder : public NodeWiseTreeBuilder {
 	std::vector<std::vector<range>> positions;
 public:
 	SplitTreeBuilder(const DMatrix<>& x, const DColumn<>& y, size_t min_samples_leaf = 1, size_t min_samples_split = 2,
-		double colsample_bytree = 1.0, double colsample_bylevel = 1.0) : x{ x }, entries{ x, y } {
+		double colsample_bytree = 1.0, double colsample_bylevel = 1.0) : x{ x }, index{ x }, y{ y }, w{ matrix::ones(x.nrows()) } {
 		this->nrows = x.nrows();
 		this->ncols = x.ncols();
 		y_mean = y.sum() / nrows;
-		entries.sort_columns();
 		this->min_samples_leaf = min_samples_leaf;
 		this->min_samples_split = min_samples_split;
 		this->colsample_bytree = colsample_bytree;
@@ -56,17 +57,21 @@ protected:
 
 		Split best_split = Split::build_unsuccessful_split();
 		MSESplitter splitter(this->min_samples_leaf);
+		const double* y = this->y.data();
+		const double* w = this->w.data();
 		const range& r0 = position[0];
 		for (size_t k = r0.start; k < r0.end; k++) {
-			const Entry& e = entries(k, 0);
-			splitter.add(e);
+			const uint32_t i = index(k, 0);
+			splitter.add(y[i], w[i]);
 		}
 		for (const auto& col : columns) {
 			const range& r = position[col];
+			const uint32_t* order = index.column_data(col);
+			const double* xcol = x.column_data(col);
 			splitter.start_splitting(col);
 			for (size_t k = r.start; k < r.end; k++) {
-				const Entry& e = entries(k, col);
-				const Split& split = splitter.build_split(e);
+				const uint32_t i = order[k];
+				const Split& split = splitter.build_split(i, xcol[i], y[i], w[i]);
 				if (!split.succesful) continue;
 				if (split > best_split) best_split = split;
 			}
@@ -106,13 +111,14 @@ protected:
 			l_range.end = p_range.start + best_split.l_n;
 			r_range.start = p_range.start + best_split.l_n;
 			r_range.end = p_range.end;
-			const auto& x = this->x;
+			const double* xsplit = x.column_data(best_split.column);
 			if (col != best_split.column) {
+				uint32_t* order = index.column_data(col);
 				std::stable_partition(
-					&entries(p_range.start, col),
-					&entries(p_range.end, col),
-					[x, best_split](const Entry& e) {
-						return x(e.i, best_split.column) < best_split.threshold;
+					order + p_range.start,
+					order + p_range.end,
+					[xsplit, best_split](const uint32_t i) {
+						return xsplit[i] < best_split.threshold;
 					}
 				);
 			}
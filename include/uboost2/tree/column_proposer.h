@@ -8,7 +8,9 @@ class ColumnProposer {
 	double colsample_bylevel = 1.0;
 	std::default_random_engine generator;
 public:
-	ColumnProposer(size_t ncols, double colsample_bytree, double colsample_bylevel) {
+	// the default seed draws the same columns as a default-constructed engine
+	ColumnProposer(size_t ncols, double colsample_bytree, double colsample_bylevel,
+		unsigned seed = std::default_random_engine::default_seed) : generator{ seed } {
 		this->colsample_bylevel = colsample_bylevel;
 
 		size_t n = (size_t)(ncols * colsample_bytree);
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <memory>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+#include <uboost2/data.h>
+#include <uboost2/tree/tree.h>
+
+// 16 bytes per node: a leaf keeps its value, a split its threshold, never both
+struct CompiledNode {
+	// the top bit of feature sends the missing values left
+	static constexpr uint32_t DEFAULT_LEFT = 0x80000000u;
+	double threshold_or_value = 0.0;
+	uint32_t feature = 0;
+	// position of the left child, the right one follows it; 0 marks a leaf (the root is nobody's child)
+	uint32_t left = 0;
+	inline bool is_leaf() const {
+		return left == 0;
+	}
+	inline uint32_t column() const {
+		return feature & ~DEFAULT_LEFT;
+	}
+	inline bool default_left() const {
+		return feature & DEFAULT_LEFT;
+	}
+};
+static_assert(sizeof(CompiledNode) == 16, "CompiledNode must stay 16 bytes");
+
+// inference-only copy of a Tree: the reachable nodes packed breadth-first, siblings side by side
+// copies are shallow, like DMatrix: the nodes are owned by m_base, an internal vector or a wrapped
+// buffer (e.g. a mapped model file)
+class CompiledTree {
+	std::shared_ptr<void> m_base;
+	const CompiledNode* nodes = nullptr;
+	size_t n_nodes = 0;
+	// columns a matrix needs for the splits
+	size_t n_features = 0;
+public:
+	CompiledTree(const Tree& tree) {
+		std::queue<size_t> queue;
+		std::vector<size_t> source;
+		queue.push(trees::ROOTID);
+		while (!queue.empty()) {
+			size_t nid = queue.front();
+			queue.pop();
+			source.push_back(nid);
+			if (tree[nid].is_leaf) continue;
+			queue.push(trees::left_child(nid));
+			queue.push(trees::right_child(nid));
+		}
+		assert(source.size() <= std::numeric_limits<uint32_t>::max());
+		auto storage = std::make_shared<std::vector<CompiledNode>>(source.size());
+		std::vector<CompiledNode>& out_nodes = *storage;
+		// children are enqueued in pairs, so they land next to each other in the same order
+		uint32_t next = 1;
+		for (size_t k = 0; k < source.size(); k++) {
+			const TreeNode& node = tree[source[k]];
+			CompiledNode& out = out_nodes[k];
+			if (node.is_leaf) {
+				out.threshold_or_value = node.value;
+				continue;
+			}
+			assert(node.column < CompiledNode::DEFAULT_LEFT);
+			out.threshold_or_value = node.threshold;
+			out.feature = (uint32_t)node.column | (node.default_left ? CompiledNode::DEFAULT_LEFT : 0);
+			out.left = next;
+			next += 2;
+			n_features = std::max(n_features, node.column + 1);
+		}
+		nodes = storage->data();
+		n_nodes = storage->size();
+		m_base = storage;
+	}
+	// non-owning view of size packed nodes, base (if any) is held as long as the tree lives
+	CompiledTree(const CompiledNode* nodes, size_t size, std::shared_ptr<void> base = nullptr) :
+		m_base{ base }, nodes{ nodes }, n_nodes{ size } {
+		assert(nodes != nullptr && size > 0);
+		for (size_t k = 0; k < size; k++) {
+			if (!nodes[k].is_leaf()) n_features = std::max<size_t>(n_features, nodes[k].column() + 1);
+		}
+	}
+	// leaves are numbered by their position in the compiled layout, not by their Tree id
+	template <typename X>
+	inline size_t predict_leaf(const DMatrix<X>& x, size_t i) const {
+		uint32_t k = 0;
+		while (!nodes[k].is_leaf()) {
+			const CompiledNode& node = nodes[k];
+			const X v = x(i, node.column());
+			k = node.left + (is_missing(v) ? !node.default_left() : v >= node.threshold_or_value);
+		}
+		return k;
+	}
+	template <typename X>
+	inline double predict_value_row(const DMatrix<X>& x, size_t i) const {
+		return nodes[predict_leaf(x, i)].threshold_or_value;
+	}
+	template <typename X>
+	DColumn<> predict_value(const DMatrix<X>& x) const {
+		if (x.ncols() < n_features) throw std::runtime_error("Matrix has fewer columns than the tree splits on");
+		DColumn<> out(x.nrows());
+		for (size_t i = 0; i < x.nrows(); i++) {
+			out(i) = predict_value_row(x, i);
+		}
+		return out;
+	}
+	//
+	size_t size() const {
+		return n_nodes;
+	}
+	size_t get_n_features() const {
+		return n_features;
+	}
+	size_t memory_usage() const {
+		return n_nodes * sizeof(CompiledNode);
+	}
+	const CompiledNode* data() const {
+		return nodes;
+	}
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <cassert>
+
+#include <uboost2/data.h>
+#include <uboost2/losses.h>
+#include <uboost2/tree/sorted_index.h>
+#include <uboost2/tree/binning.h>
+
+// training data that outlives a single tree: the columns are sorted (or quantized) once,
+// only the targets/gradients are refreshed between boosting rounds
+// copies are shallow, every copy refers to the same storage
+// X is the precision of the features (float halves the bytes read by the split scans), the
+// targets/gradients stay in double
+template <typename X = double>
+class Dataset {
+	// built on first use, shared by all the copies
+	struct Cache {
+		std::shared_ptr<SortedIndex> index;
+		std::shared_ptr<BinMatrix> bins;
+	};
+	DMatrix<X> x;
+	DColumn<> y, g, h, w;
+	std::shared_ptr<Cache> cache;
+	int n_threads = 1;
+protected:
+	static void copy_column(DColumn<>& dst, const DColumn<>& src) {
+		assert(dst.nrows() == src.nrows());
+		std::copy(src.data(), src.data() + src.nrows(), dst.data());
+	}
+public:
+	Dataset(const DMatrix<X>& x, int n_threads = 1) :
+		x{ x }, y{ x.nrows(), 0.0 }, g{ x.nrows(), 0.0 }, h{ x.nrows(), 1.0 }, w{ x.nrows(), 1.0 },
+		cache{ std::make_shared<Cache>() }, n_threads{ n_threads } {}
+	// features with their index/bins already built (e.g. mapped from a dataset file), bins may be null
+	Dataset(const DMatrix<X>& x, std::shared_ptr<SortedIndex> index, std::shared_ptr<BinMatrix> bins, int n_threads = 1) :
+		Dataset(x, n_threads) {
+		cache->index = std::move(index);
+		cache->bins = std::move(bins);
+	}
+	//
+	size_t nrows() const {
+		return x.nrows();
+	}
+	size_t ncols() const {
+		return x.ncols();
+	}
+	//
+	void set_y(const DColumn<>& y) {
+		copy_column(this->y, y);
+	}
+	void set_g(const DColumn<>& g) {
+		copy_column(this->g, g);
+	}
+	void set_h(const DColumn<>& h) {
+		copy_column(this->h, h);
+	}
+	void set_w(const DColumn<>& w) {
+		copy_column(this->w, w);
+	}
+	// gradients of the loss at the raw scores p, written in place: g = scale * grad and h = hess,
+	// or h = 1 when newton is false (plain gradient descent)
+	void update_gradients(const Loss& loss, const DColumn<>& p, double scale = 1.0, bool newton = true) {
+		if (newton) loss.grad_and_hess(y, p, g, h, scale, n_threads);
+		else {
+			loss.grad(y, p, g, scale, n_threads);
+			std::fill(h.data(), h.data() + h.nrows(), 1.0);
+		}
+	}
+	// copy with its own row weights (a bootstrap, a subsample), sharing everything else
+	Dataset<X> with_w(const DColumn<>& w) const {
+		assert(w.nrows() == nrows());
+		Dataset<X> out(*this);
+		out.w = w;
+		return out;
+	}
+	//
+	const DMatrix<X>& get_x() const {
+		return x;
+	}
+	const SortedIndex& get_index() {
+		if (!cache->index) cache->index = std::make_shared<SortedIndex>(x, n_threads);
+		return *cache->index;
+	}
+	const DColumn<>& get_y() const {
+		return y;
+	}
+	const DColumn<>& get_g() const {
+		return g;
+	}
+	const DColumn<>& get_h() const {
+		return h;
+	}
+	const DColumn<>& get_w() const {
+		return w;
+	}
+	// quantized features, kept while max_bins does not change
+	const BinMatrix& get_bins(size_t max_bins = MAX_BINS) {
+		if (!cache->bins || cache->bins->get_max_bins() != max_bins) cache->bins = std::make_shared<BinMatrix>(x, max_bins, n_threads);
+		return *cache->bins;
+	}
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+#include <uboost2/data.h>
+#include <uboost2/mapped_file.h>
+#include <uboost2/parallel.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/tree/sorted_index.h>
+#include <uboost2/tree/binning.h>
+
+// prepared training data on disk: the features, their sort permutations and (optionally) their bins,
+// written once and mapped by every process that trains on them
+// layout: the header, then one section per array, each starting on a 64-byte boundary
+//   x          nrows * ncols features, column-major
+//   index      nrows * ncols uint32 row ids, column-major; n_missing: ncols uint64
+//   bins       nrows * ncols uint8 bin indices, column-major; cuts: ncols uint64 counts, then the doubles
+// multi-byte values are in the byte order of the writer, a reader with another one refuses the file
+namespace datasets {
+	constexpr char MAGIC[8] = { 'U', 'B', '2', 'D', 'A', 'T', 'A', '\0' };
+	constexpr uint32_t VERSION = 2;
+	constexpr uint32_t BYTE_ORDER_MARK = 0x01020304u;
+	constexpr size_t ALIGNMENT = 64;
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t feature_size;
+		// 0 when the bins are not stored
+		uint32_t max_bins;
+		uint64_t nrows, ncols;
+		// from the start of the file, 0 when absent
+		uint64_t x_offset, index_offset, n_missing_offset, bins_offset, cuts_offset;
+	};
+
+	namespace detail {
+		inline void pad(std::ofstream& out) {
+			static const char zeros[ALIGNMENT] = {};
+			const size_t pos = (size_t)out.tellp();
+			if (pos % ALIGNMENT) out.write(zeros, ALIGNMENT - pos % ALIGNMENT);
+		}
+		inline uint64_t write(std::ofstream& out, const void* p, size_t bytes) {
+			pad(out);
+			const uint64_t offset = (uint64_t)out.tellp();
+			out.write(static_cast<const char*>(p), bytes);
+			return offset;
+		}
+		template <typename T>
+		uint64_t write_columns(std::ofstream& out, const DMatrix<T>& m) {
+			pad(out);
+			const uint64_t offset = (uint64_t)out.tellp();
+			for (size_t j = 0; j < m.ncols(); j++) out.write(reinterpret_cast<const char*>(m.column_data(j)), m.nrows() * sizeof(T));
+			return offset;
+		}
+		inline void check_section(const MappedFile& file, uint64_t offset, uint64_t bytes) {
+			if (offset % ALIGNMENT || offset > file.size() || bytes > file.size() - offset) {
+				throw std::runtime_error("Dataset file truncated or corrupted");
+			}
+		}
+		inline FileHeader read_header(const MappedFile& file) {
+			FileHeader header;
+			if (file.size() < sizeof(FileHeader)) throw std::runtime_error("Not a dataset file");
+			std::memcpy(&header, file.data(), sizeof(FileHeader));
+			if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error("Not a dataset file");
+			if (header.byte_order != BYTE_ORDER_MARK) throw std::runtime_error("Dataset file written with another byte order");
+			if (header.version != VERSION) throw std::runtime_error("Unsupported dataset file version " + std::to_string(header.version));
+			return header;
+		}
+	}
+
+	// writes x, its sorted index and, when max_bins > 0, its bins; whatever is missing is built first
+	// the file is written aside and renamed into place: data may be mapped from path itself
+	template <typename X>
+	void save(Dataset<X>& data, const std::string& path, size_t max_bins = 0) {
+		const std::string tmp_path = path + ".tmp";
+		std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+		if (!out) throw std::runtime_error("Cannot open " + tmp_path);
+		FileHeader header{};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.byte_order = BYTE_ORDER_MARK;
+		header.feature_size = sizeof(X);
+		header.max_bins = (uint32_t)max_bins;
+		header.nrows = data.nrows();
+		header.ncols = data.ncols();
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		header.x_offset = detail::write_columns(out, data.get_x());
+		const SortedIndex& index = data.get_index();
+		header.index_offset = detail::write_columns<uint32_t>(out, index);
+		std::vector<uint64_t> n_missing(data.ncols());
+		for (size_t col = 0; col < data.ncols(); col++) n_missing[col] = index.get_n_missing(col);
+		header.n_missing_offset = detail::write(out, n_missing.data(), n_missing.size() * sizeof(uint64_t));
+		if (max_bins > 0) {
+			const BinMatrix& bins = data.get_bins(max_bins);
+			header.bins_offset = detail::write_columns<uint8_t>(out, bins);
+			std::vector<uint64_t> counts(data.ncols());
+			for (size_t col = 0; col < data.ncols(); col++) counts[col] = bins.get_cuts(col).size();
+			header.cuts_offset = detail::write(out, counts.data(), counts.size() * sizeof(uint64_t));
+			for (size_t col = 0; col < data.ncols(); col++) {
+				const auto& cuts = bins.get_cuts(col);
+				out.write(reinterpret_cast<const char*>(cuts.data()), cuts.size() * sizeof(double));
+			}
+		}
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.close();
+		if (!out) {
+			std::remove(tmp_path.c_str());
+			throw std::runtime_error("Cannot write " + tmp_path);
+		}
+		if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+			std::remove(tmp_path.c_str());
+			throw std::runtime_error("Cannot rename " + tmp_path + " to " + path);
+		}
+	}
+
+	// bytes per feature of a dataset file (4 for float, 8 for double)
+	inline size_t feature_size(const std::string& path) {
+		MappedFile file(path);
+		return detail::read_header(file).feature_size;
+	}
+
+	// maps the file: nothing is sorted or copied but the per-column counts and cuts,
+	// the arrays are read-only views that keep the mapping alive
+	// the row ids and bin codes are used as indices and are checked once here
+	template <typename X>
+	Dataset<X> load(const std::string& path, int n_threads = 1) {
+		n_threads = parallel::resolve_n_threads(n_threads);
+		auto file = std::make_shared<MappedFile>(path);
+		const FileHeader header = detail::read_header(*file);
+		if (header.feature_size != sizeof(X)) throw std::runtime_error("Dataset file features have another precision");
+		const size_t nrows = header.nrows, ncols = header.ncols;
+		if (nrows == 0 || ncols == 0) throw std::runtime_error("Empty dataset file");
+		const char* base = file->data();
+
+		detail::check_section(*file, header.x_offset, nrows * ncols * sizeof(X));
+		DMatrix<X> x(reinterpret_cast<X*>(const_cast<char*>(base + header.x_offset)), nrows, ncols, file);
+
+		detail::check_section(*file, header.index_offset, nrows * ncols * sizeof(uint32_t));
+		detail::check_section(*file, header.n_missing_offset, ncols * sizeof(uint64_t));
+		DMatrix<uint32_t> order(reinterpret_cast<uint32_t*>(const_cast<char*>(base + header.index_offset)), nrows, ncols, file);
+		const uint64_t* n_missing = reinterpret_cast<const uint64_t*>(base + header.n_missing_offset);
+		size_t n_bad = 0;
+		for (size_t col = 0; col < ncols; col++) n_bad += n_missing[col] > nrows;
+		#pragma omp parallel for num_threads(n_threads) reduction(+:n_bad)
+		for (int col = 0; col < (int)ncols; col++) {
+			const uint32_t* rows = order.column_data(col);
+			for (size_t r = 0; r < nrows; r++) n_bad += rows[r] >= nrows;
+		}
+		if (n_bad > 0) throw std::runtime_error("Dataset file truncated or corrupted");
+		auto index = std::make_shared<SortedIndex>(order, std::vector<size_t>(n_missing, n_missing + ncols));
+
+		std::shared_ptr<BinMatrix> bins;
+		if (header.max_bins > 0) {
+			detail::check_section(*file, header.bins_offset, nrows * ncols);
+			detail::check_section(*file, header.cuts_offset, ncols * sizeof(uint64_t));
+			DMatrix<uint8_t> codes(reinterpret_cast<uint8_t*>(const_cast<char*>(base + header.bins_offset)), nrows, ncols, file);
+			const uint64_t* counts = reinterpret_cast<const uint64_t*>(base + header.cuts_offset);
+			const double* values = reinterpret_cast<const double*>(counts + ncols);
+			std::vector<std::vector<double>> cuts(ncols);
+			uint64_t total = 0;
+			for (size_t col = 0; col < ncols; col++) {
+				// the missing bin, counts[col] + 1, has to fit a code
+				if (counts[col] > MAX_BINS - 2) throw std::runtime_error("Dataset file truncated or corrupted");
+				total += counts[col];
+			}
+			if (total * sizeof(double) > file->size() - header.cuts_offset - ncols * sizeof(uint64_t)) {
+				throw std::runtime_error("Dataset file truncated or corrupted");
+			}
+			for (size_t col = 0; col < ncols; col++) {
+				cuts[col].assign(values, values + counts[col]);
+				values += counts[col];
+			}
+			#pragma omp parallel for num_threads(n_threads) reduction(+:n_bad)
+			for (int col = 0; col < (int)ncols; col++) {
+				const uint8_t* column = codes.column_data(col);
+				const uint64_t missing_bin = counts[col] + 1;
+				for (size_t r = 0; r < nrows; r++) n_bad += column[r] > missing_bin;
+			}
+			if (n_bad > 0) throw std::runtime_error("Dataset file truncated or corrupted");
+			bins = std::make_shared<BinMatrix>(codes, std::move(cuts), header.max_bins);
+		}
+		return Dataset<X>(x, index, bins, n_threads);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <cassert>
+
+#include <uboost2/data.h>
+#include <uboost2/parallel.h>
+#include <uboost2/tree/tree.h>
+#include <uboost2/tree/compiled_tree.h>
+
+// additive ensemble of trees: prediction = base_score + sum of the clipped tree values
+// the trees are kept in their compiled form, training statistics are dropped
+class Ensemble {
+	std::vector<CompiledTree> trees;
+	double base_score = 0.0;
+	double max_delta_step = INFINITY;
+	// columns a matrix needs for the splits of all the trees
+	size_t n_features = 0;
+	// rows scored against every tree before moving on, so their features stay in cache
+	static constexpr size_t ROW_BLOCK = 256;
+public:
+	Ensemble(double base_score = 0.0, double max_delta_step = INFINITY) {
+		this->base_score = base_score;
+		this->max_delta_step = max_delta_step;
+	}
+	//
+	void add(const Tree& tree) {
+		add(CompiledTree(tree));
+	}
+	void add(const CompiledTree& tree) {
+		trees.push_back(tree);
+		n_features = std::max(n_features, tree.get_n_features());
+	}
+	size_t size() const {
+		return trees.size();
+	}
+	const std::vector<CompiledTree>& get_trees() const {
+		return trees;
+	}
+	double get_base_score() const {
+		return base_score;
+	}
+	double get_max_delta_step() const {
+		return max_delta_step;
+	}
+	size_t get_n_features() const {
+		return n_features;
+	}
+	size_t memory_usage() const {
+		size_t out = 0;
+		for (const auto& tree : trees) out += tree.memory_usage();
+		return out;
+	}
+	// adds the prediction of every row to out
+	template <typename X>
+	void predict_inplace(const DMatrix<X>& x, DColumn<>& out, int n_threads = 1) const {
+		assert(out.nrows() == x.nrows());
+		if (x.ncols() < n_features) throw std::runtime_error("Matrix has fewer columns than the ensemble splits on");
+		const size_t nrows = x.nrows();
+		const size_t n_blocks = (nrows + ROW_BLOCK - 1) / ROW_BLOCK;
+		double* p = out.data();
+		n_threads = parallel::resolve_n_threads(n_threads);
+		#pragma omp parallel for num_threads(n_threads) schedule(static)
+		for (int b = 0; b < (int)n_blocks; b++) {
+			const size_t i0 = b * ROW_BLOCK, i1 = std::min(i0 + ROW_BLOCK, nrows);
+			for (size_t i = i0; i < i1; i++) p[i] += base_score;
+			for (const CompiledTree& tree : trees) {
+				for (size_t i = i0; i < i1; i++) {
+					const double v = tree.predict_value_row(x, i);
+					p[i] += std::clamp(v, -max_delta_step, max_delta_step);
+				}
+			}
+		}
+	}
+	template <typename X>
+	DColumn<> predict(const DMatrix<X>& x, int n_threads = 1) const {
+		DColumn<> out(x.nrows(), 0.0);
+		predict_inplace(x, out, n_threads);
+		return out;
+	}
+};
@@ -26,82 +26,6 @@ struct Entry {
 	}
 };
 
-class EntryMatrix : public DMatrix<Entry> {
-	double y_mean;
-public:
-	EntryMatrix(const DMatrix<>& x, const DColumn<>& y) : DMatrix<Entry>{ x.nrows(), x.ncols() } {
-		assert(x.nrows() == y.nrows());
-		for (size_t i = 0; i < x.nrows(); i++) {
-			for (size_t j = 0; j < x.ncols(); j++) {
-				auto xij = x(i, j);
-				Entry e(i, xij, y(i));
-				DMatrix<Entry>::operator()(i, j) = e;
-			}
-		}
-		y_mean = y.sum() / y.nrows();
-	}
-	EntryMatrix(const DMatrix<>& x, const DColumn<>& y, const DColumn<>& w) : DMatrix<Entry>{ x.nrows(), x.ncols() } {
-		assert(x.nrows() == y.nrows());
-		assert(x.nrows() == w.nrows());
-		for (size_t i = 0; i < x.nrows(); i++) {
-			for (size_t j = 0; j < x.ncols(); j++) {
-				auto xij = x(i, j);
-				Entry e(i, xij, y(i), w(i));
-				DMatrix<Entry>::operator()(i, j) = e;
-			}
-		}
-		y_mean = y.sum() / y.nrows();
-	}
-	//
-	void set_x(const DMatrix<>& x) {
-		assert(nrows() == y.nrows());
-		for (size_t k = 0; k < nrows(); k++) {
-			for (size_t j = 0; j < ncols(); j++) {
-				auto& e = DMatrix<Entry>::operator()(k, j);
-				size_t i = e.i;
-				e.x = x(i, j);
-			}
-		}
-	}
-	void set_y(const DColumn<>& y) {
-		assert(nrows() == y.nrows());
-		for (size_t k = 0; k < nrows(); k++) {
-			for (size_t j = 0; j < ncols(); j++) {
-				auto& e = DMatrix<Entry>::operator()(k, j);
-				size_t i = e.i;
-				e.y = y(i);
-			}
-		}
-		y_mean = y.sum() / y.nrows();
-	}
-	void set_w(const DColumn<>& w) {
-		assert(nrows() == y.nrows());
-		for (size_t k = 0; k < nrows(); k++) {
-			for (size_t j = 0; j < ncols(); j++) {
-				auto& e = DMatrix<Entry>::operator()(k, j);
-				size_t i = e.i;
-				e.w = w(i);
-			}
-		}
-	}
-	//
-	double get_y_mean() const {
-		return y_mean;
-	}
-	//
-	void sort_columns() {
-		for (size_t col = 0; col < ncols(); col++) {
-			size_t i_start = col * m_nrows;
-			size_t i_end = (col + 1) * m_nrows;
-			std::sort(
-				m_data->begin() + i_start,
-				m_data->begin() + i_end,
-				[](Entry& a, Entry& b) { return a.x < b.x; }
-			);
-		}
-	}
-};
-
 // GH
 
 struct GHEntry {
@@ -127,84 +51,48 @@ struct GHEntry {
 	}
 };
 
-class GHEntryMatrix : public DMatrix<GHEntry> {
-public:
-	GHEntryMatrix(
-		const DMatrix<>& x, const DColumn<>& g, const DColumn<>& h
-	) : DMatrix<GHEntry>{ x.nrows(), x.ncols() } {
-		assert(x.nrows() == g.nrows());
-		assert(x.nrows() == h.nrows());
-		for (size_t i = 0; i < x.nrows(); i++) {
-			for (size_t j = 0; j < x.ncols(); j++) {
-				auto xij = x(i, j);
-				auto e = GHEntry(i, x(i, j), g(i), h(i));
-				DMatrix<GHEntry>::operator()(i, j) = e;
-			}
-		}
-	}
-	GHEntryMatrix(
-		const DMatrix<>& x, const DColumn<>& g, const DColumn<>& h, const DColumn<>& w) : DMatrix<GHEntry>{ x.nrows(), x.ncols() } {
-		assert(x.nrows() == g.nrows());
-		assert(x.nrows() == h.nrows());
-		for (size_t i = 0; i < x.nrows(); i++) {
-			for (size_t j = 0; j < x.ncols(); j++) {
-				auto xij = x(i, j);
-				auto e = GHEntry(i, x(i, j), g(i), h(i), w(i));
-				DMatrix<GHEntry>::operator()(i, j) = e;
-			}
-		}
-	}
-	//
-	void set_x(const DMatrix<>& x) {
-		assert(nrows() == y.nrows());
-		for (size_t k = 0; k < nrows(); k++) {
-			for (size_t j = 0; j < ncols(); j++) {
-				auto& e = DMatrix<GHEntry>::operator()(k, j);
-				size_t i = e.i;
-				e.x = x(i, j);
-			}
-		}
-	}
-	void set_g(const DColumn<>& g) {
-		assert(nrows() == y.nrows());
-		for (size_t k = 0; k < nrows(); k++) {
-			for (size_t j = 0; j < ncols(); j++) {
-				auto& e = DMatrix<GHEntry>::operator()(k, j);
-				size_t i = e.i;
-				e.g = g(i);
-			}
-		}
-	}
-	void set_h(const DColumn<>& h) {
-		assert(nrows() == y.nrows());
-		for (size_t k = 0; k < nrows(); k++) {
-			for (size_t j = 0; j < ncols(); j++) {
-				auto& e = DMatrix<GHEntry>::operator()(k, j);
-				size_t i = e.i;
-				e.h = h(i);
-			}
-		}
-	}
-	void set_w(const DColumn<>& w) {
-		assert(nrows() == y.nrows());
-		for (size_t k = 0; k < nrows(); k++) {
-			for (size_t j = 0; j < ncols(); j++) {
-				auto& e = DMatrix<GHEntry>::operator()(k, j);
-				size_t i = e.i;
-				e.w = w(i);
-			}
-		}
+// histogram bins
+
+struct Bin {
+	double s = 0.0;
+	double s2 = 0.0;
+	double w = 0.0;
+	size_t n = 0;
+	inline void add(double y, double w) {
+		this->s += y * w;
+		this->s2 += y * y * w;
+		this->w += w;
+		this->n++;
+	}
+	// statistics of a bin of the sibling: parent minus this child
+	inline Bin complement(const Bin& parent) const {
+		Bin out;
+		out.s = parent.s - s;
+		out.s2 = parent.s2 - s2;
+		out.w = parent.w - w;
+		out.n = parent.n - n;
+		return out;
 	}
-	//
-	void sort_columns() {
-		for (size_t col = 0; col < ncols(); col++) {
-			size_t i_start = col * m_nrows;
-			size_t i_end = (col + 1) * m_nrows;
-			std::sort(
-				m_data->begin() + i_start,
-				m_data->begin() + i_end,
-				[](GHEntry& a, GHEntry& b) { return a.x < b.x; }
-			);
-		}
+};
+
+struct GHBin {
+	double g = 0.0;
+	double h = 0.0;
+	double w = 0.0;
+	size_t n = 0;
+	inline void add(double g, double h, double w) {
+		this->g += g * w;
+		this->h += h * w;
+		this->w += w;
+		this->n++;
+	}
+	// statistics of a bin of the sibling: parent minus this child
+	inline GHBin complement(const GHBin& parent) const {
+		GHBin out;
+		out.g = parent.g - g;
+		out.h = parent.h - h;
+		out.w = parent.w - w;
+		out.n = parent.n - n;
+		return out;
 	}
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cassert>
+
+#include <uboost2/data.h>
+
+// gradient-based one-side sampling
+// the top_rate fraction of the rows by |g * w| is kept, other_rate of the rows is drawn from the rest
+// and reweighted by (1 - top_rate) / other_rate so the gradient sums stay unbiased; with other_rate 0
+// only the top rows are kept
+namespace goss {
+
+	inline bool enabled(double top_rate, double other_rate) {
+		return top_rate + other_rate < 1.0;
+	}
+
+	// rows left out get position -1, the weights of the kept ones are written to sample_w
+	template <typename Generator>
+	void sample(const DColumn<>& g, const DColumn<>& w, double top_rate, double other_rate, Generator& generator,
+		std::vector<int>& position, DColumn<>& sample_w) {
+		assert(top_rate >= 0.0 && other_rate >= 0.0);
+		const size_t nrows = g.nrows();
+		const double* gp = g.data();
+		const double* wp = w.data();
+		double* sw = sample_w.data();
+
+		const size_t n_top = (size_t)(top_rate * nrows);
+		double threshold = INFINITY;
+		if (n_top > 0) {
+			std::vector<double> magnitude(nrows);
+			for (size_t i = 0; i < nrows; i++) magnitude[i] = std::abs(gp[i] * wp[i]);
+			std::nth_element(magnitude.begin(), magnitude.begin() + (n_top - 1), magnitude.end(), std::greater<double>());
+			threshold = magnitude[n_top - 1];
+		}
+
+		const double amplify = other_rate > 0.0 ? (1.0 - top_rate) / other_rate : 0.0;
+		std::bernoulli_distribution keep(std::min(1.0, other_rate / (1.0 - top_rate)));
+		for (size_t i = 0; i < nrows; i++) {
+			if (std::abs(gp[i] * wp[i]) >= threshold) sw[i] = wp[i];
+			else if (other_rate > 0.0 && keep(generator)) sw[i] = wp[i] * amplify;
+			else {
+				sw[i] = 0.0;
+				position[i] = -1;
+			}
+		}
+	}
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include <uboost2/mapped_file.h>
+#include <uboost2/tree/tree.h>
+#include <uboost2/tree/compiled_tree.h>
+#include <uboost2/tree/ensemble.h>
+
+// binary models, little-endian and versioned, read back without parsing:
+//   tree       header, then one fixed-size record per slot of the node array (max_depth levels)
+//   ensemble   header, n_trees + 1 uint64 node offsets, then from a 64-byte boundary the CompiledNode
+//              arrays of all the trees back to back
+// a mapped ensemble is scored in place: its trees are views of the file
+namespace models {
+	constexpr char TREE_MAGIC[8] = { 'U', 'B', '2', 'T', 'R', 'E', 'E', '\0' };
+	constexpr char ENSEMBLE_MAGIC[8] = { 'U', 'B', '2', 'E', 'N', 'S', 'M', '\0' };
+	constexpr uint32_t VERSION = 1;
+	constexpr size_t ALIGNMENT = 64;
+
+	struct TreeHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t max_depth;
+		uint64_t n_nodes;
+	};
+	struct TreeNodeRecord {
+		double value, threshold, criterion, gain;
+		uint64_t column, n;
+		uint8_t is_leaf, default_left;
+		uint8_t padding[6];
+	};
+	static_assert(sizeof(TreeNodeRecord) == 56, "TreeNodeRecord must stay 56 bytes");
+	struct EnsembleHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+		double base_score, max_delta_step;
+		uint64_t n_trees, n_nodes;
+	};
+
+	namespace detail {
+		inline void check_byte_order() {
+			if constexpr (std::endian::native != std::endian::little) {
+				throw std::runtime_error("Model files are little-endian only");
+			}
+		}
+		inline void pad(std::ostream& out) {
+			static const char zeros[ALIGNMENT] = {};
+			const size_t pos = (size_t)out.tellp();
+			if (pos % ALIGNMENT) out.write(zeros, ALIGNMENT - pos % ALIGNMENT);
+		}
+		template <typename Header>
+		Header read_header(const char* data, size_t size, const char* magic) {
+			Header header;
+			if (size < sizeof(Header)) throw std::runtime_error("Not a model file");
+			std::memcpy(&header, data, sizeof(Header));
+			if (std::memcmp(header.magic, magic, 8) != 0) throw std::runtime_error("Not a model file of this kind");
+			if (header.version != VERSION) throw std::runtime_error("Unsupported model file version " + std::to_string(header.version));
+			return header;
+		}
+		// bytes of a pickled model in an 8-byte aligned buffer of its own
+		inline std::shared_ptr<std::vector<uint64_t>> aligned_copy(const std::string& bytes) {
+			auto buffer = std::make_shared<std::vector<uint64_t>>((bytes.size() + 7) / 8);
+			std::memcpy(buffer->data(), bytes.data(), bytes.size());
+			return buffer;
+		}
+	}
+
+	// tree
+
+	inline void write(std::ostream& out, const Tree& tree) {
+		detail::check_byte_order();
+		TreeHeader header{};
+		std::memcpy(header.magic, TREE_MAGIC, sizeof(TREE_MAGIC));
+		header.version = VERSION;
+		header.max_depth = (uint32_t)tree.get_max_depth();
+		header.n_nodes = trees::max_idx_at_depth(tree.get_max_depth()) + 1;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		std::vector<TreeNodeRecord> records(header.n_nodes);
+		for (size_t nid = 0; nid < records.size(); nid++) {
+			const TreeNode& node = tree[nid];
+			TreeNodeRecord& r = records[nid];
+			r = TreeNodeRecord{};
+			r.value = node.value;
+			r.threshold = node.threshold;
+			r.criterion = node.criterion;
+			r.gain = node.gain;
+			r.column = node.column;
+			r.n = node.n;
+			r.is_leaf = node.is_leaf;
+			r.default_left = node.default_left;
+		}
+		out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TreeNodeRecord));
+	}
+	inline Tree read_tree(const char* data, size_t size) {
+		detail::check_byte_order();
+		const TreeHeader header = detail::read_header<TreeHeader>(data, size, TREE_MAGIC);
+		if (header.max_depth > 15 || header.n_nodes != trees::max_idx_at_depth(header.max_depth) + 1
+			|| header.n_nodes * sizeof(TreeNodeRecord) > size - sizeof(TreeHeader)) {
+			throw std::runtime_error("Tree file truncated or corrupted");
+		}
+		Tree tree(header.max_depth);
+		const char* p = data + sizeof(TreeHeader);
+		for (size_t nid = 0; nid < header.n_nodes; nid++, p += sizeof(TreeNodeRecord)) {
+			TreeNodeRecord r;
+			std::memcpy(&r, p, sizeof(r));
+			TreeNode& node = tree[nid];
+			node.value = r.value;
+			node.threshold = r.threshold;
+			node.criterion = r.criterion;
+			node.gain = r.gain;
+			node.column = r.column;
+			node.n = r.n;
+			node.is_leaf = r.is_leaf;
+			node.default_left = r.default_left;
+		}
+		// the nodes of the last level have no children to go to
+		const size_t last_level = header.max_depth > 0 ? trees::max_idx_at_depth(header.max_depth - 1) + 1 : 0;
+		for (size_t nid = last_level; nid < header.n_nodes; nid++) {
+			if (!tree[nid].is_leaf) throw std::runtime_error("Tree file truncated or corrupted");
+		}
+		return tree;
+	}
+
+	// ensemble
+
+	inline void write(std::ostream& out, const Ensemble& ensemble) {
+		detail::check_byte_order();
+		const auto& trees = ensemble.get_trees();
+		std::vector<uint64_t> offsets(trees.size() + 1, 0);
+		for (size_t t = 0; t < trees.size(); t++) offsets[t + 1] = offsets[t] + trees[t].size();
+		EnsembleHeader header{};
+		std::memcpy(header.magic, ENSEMBLE_MAGIC, sizeof(ENSEMBLE_MAGIC));
+		header.version = VERSION;
+		header.base_score = ensemble.get_base_score();
+		header.max_delta_step = ensemble.get_max_delta_step();
+		header.n_trees = trees.size();
+		header.n_nodes = offsets.back();
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+		detail::pad(out);
+		for (const CompiledTree& tree : trees) {
+			out.write(reinterpret_cast<const char*>(tree.data()), tree.size() * sizeof(CompiledNode));
+		}
+	}
+	// data must be 8-byte aligned and stay alive with base: the trees point into it
+	inline Ensemble read_ensemble(const char* data, size_t size, std::shared_ptr<void> base) {
+		detail::check_byte_order();
+		const EnsembleHeader header = detail::read_header<EnsembleHeader>(data, size, ENSEMBLE_MAGIC);
+		const size_t offsets_end = sizeof(EnsembleHeader) + (header.n_trees + 1) * sizeof(uint64_t);
+		const size_t nodes_begin = (offsets_end + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		if (header.n_trees > size / sizeof(uint64_t) || nodes_begin > size
+			|| header.n_nodes > (size - nodes_begin) / sizeof(CompiledNode)) {
+			throw std::runtime_error("Ensemble file truncated or corrupted");
+		}
+		const uint64_t* offsets = reinterpret_cast<const uint64_t*>(data + sizeof(EnsembleHeader));
+		const CompiledNode* nodes = reinterpret_cast<const CompiledNode*>(data + nodes_begin);
+		Ensemble ensemble(header.base_score, header.max_delta_step);
+		for (size_t t = 0; t < header.n_trees; t++) {
+			const uint64_t begin = offsets[t], end = offsets[t + 1];
+			if (begin >= end || end > header.n_nodes) throw std::runtime_error("Ensemble file truncated or corrupted");
+			// a child outside the tree would send the scoring out of the buffer, one before its parent
+			// could send it round in a loop: children follow their parent, as CompiledTree lays them out
+			for (uint64_t k = begin; k < end; k++) {
+				const CompiledNode& node = nodes[k];
+				if (!node.is_leaf() && (node.left <= k - begin || node.left + 1 >= end - begin)) {
+					throw std::runtime_error("Ensemble file truncated or corrupted");
+				}
+			}
+			ensemble.add(CompiledTree(nodes + begin, end - begin, base));
+		}
+		return ensemble;
+	}
+
+	// files
+
+	template <typename Model>
+	void save(const Model& model, const std::string& path) {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) throw std::runtime_error("Cannot open " + path);
+		write(out, model);
+		if (!out) throw std::runtime_error("Cannot write " + path);
+	}
+	inline Tree load_tree(const std::string& path) {
+		MappedFile file(path);
+		return read_tree(file.data(), file.size());
+	}
+	// the file stays mapped as long as one of the trees lives
+	inline Ensemble load_ensemble(const std::string& path) {
+		auto file = std::make_shared<MappedFile>(path);
+		return read_ensemble(file->data(), file->size(), file);
+	}
+
+	// bytes, for pickling
+
+	template <typename Model>
+	std::string to_bytes(const Model& model) {
+		std::ostringstream out(std::ios::binary);
+		write(out, model);
+		return out.str();
+	}
+	inline Tree tree_from_bytes(const std::string& bytes) {
+		return read_tree(bytes.data(), bytes.size());
+	}
+	inline Ensemble ensemble_from_bytes(const std::string& bytes) {
+		auto buffer = detail::aligned_copy(bytes);
+		return read_ensemble(reinterpret_cast<const char*>(buffer->data()), bytes.size(), buffer);
+	}
+}
@@ -2,9 +2,12 @@
 
 #include <stack>
 #include <queue>
+#include <vector>
+#include <functional>
 
 class NodeProposer {
 public:
+	virtual ~NodeProposer() {}
 	virtual void push(size_t nid, double criterion = 0.0) = 0;
 	virtual size_t get_and_pop() = 0;
 	virtual size_t size() const = 0;
@@ -42,29 +45,35 @@ public:
 	}
 };
 
-class LowerFirstNodeProposer : public NodeProposer {
-	std::vector<size_t> ids;
-	std::vector<double> scores;
+// binary heap on the criterion: the best node is popped in O(log n), the oldest one among equals
+template <typename Better>
+class PriorityNodeProposer : public NodeProposer {
+	struct Item {
+		double criterion;
+		size_t order;
+		size_t nid;
+	};
+	struct Worse {
+		bool operator()(const Item& a, const Item& b) const {
+			if (a.criterion != b.criterion) return Better()(b.criterion, a.criterion);
+			return a.order > b.order;
+		}
+	};
+	std::priority_queue<Item, std::vector<Item>, Worse> heap;
+	size_t order = 0;
 public:
 	void push(size_t nid, double criterion = 0.0) override {
-		ids.push_back(nid);
-		scores.push_back(criterion);
+		heap.push(Item{ criterion, order++, nid });
 	}
 	size_t get_and_pop() override {
-		size_t k_best = 0;
-		double crit_best = scores[0];
-		for (size_t k = 0; k < size(); k++) {
-			if (scores[k] < crit_best) {
-				crit_best = scores[k];
-				k_best = k;
-			}
-		}
-		size_t nid = ids[k_best];
-		ids.erase(ids.begin() + k_best);
-		scores.erase(scores.begin() + k_best);
+		size_t nid = heap.top().nid;
+		heap.pop();
 		return nid;
 	}
 	size_t size() const override {
-		return ids.size();
+		return heap.size();
 	}
-};
\ No newline at end of file
+};
+
+using LowerFirstNodeProposer = PriorityNodeProposer<std::less<double>>;
+using HigherFirstNodeProposer = PriorityNodeProposer<std::greater<double>>;
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+#include <uboost2/data.h>
+#include <uboost2/parallel.h>
+#include <uboost2/tree/binning.h>
+#include <uboost2/tree/quantile_sketch.h>
+
+// binned training data too large for memory: the bin codes live on disk in row pages and are
+// streamed through a few page buffers, only the per-row targets/gradients stay in memory
+// layout: the header, the cuts (ncols uint64 counts, then the doubles), then the pages, each on a
+// 4096-byte boundary; page p holds rows [p * page_rows, (p + 1) * page_rows), column-major,
+// one uint8 bin code per cell (missing values in a bin of their own after the others, as in BinMatrix)
+// multi-byte values are in the byte order of the writer, a reader with another one refuses the file
+namespace paging {
+	constexpr char MAGIC[8] = { 'U', 'B', '2', 'P', 'A', 'G', 'E', '\0' };
+	constexpr uint32_t VERSION = 2;
+	constexpr uint32_t BYTE_ORDER_MARK = 0x01020304u;
+	constexpr size_t ALIGNMENT = 4096;
+	constexpr size_t PAGE_ROWS = 1 << 16;
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t max_bins;
+		uint32_t reserved;
+		uint64_t nrows, ncols, page_rows, n_pages;
+		// from the start of the file
+		uint64_t cuts_offset, pages_offset;
+	};
+
+	namespace detail {
+		inline size_t round_up(size_t n) {
+			return (n + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		}
+		inline void pad(std::ofstream& out) {
+			static const char zeros[ALIGNMENT] = {};
+			const size_t pos = (size_t)out.tellp();
+			if (pos % ALIGNMENT) out.write(zeros, ALIGNMENT - pos % ALIGNMENT);
+		}
+		// as BinMatrix::get_bin
+		inline uint8_t get_bin(const std::vector<double>& cuts, double x) {
+			if (is_missing(x)) return (uint8_t)(cuts.size() + 1);
+			return (uint8_t)(std::upper_bound(cuts.begin(), cuts.end(), x) - cuts.begin());
+		}
+	}
+
+	// writes a paged file from chunks of rows, in two passes over the source: sketch() every chunk
+	// (or give the cuts), then append() them in row order and close()
+	// memory: the column sketches and one page, whatever the number of rows
+	template <typename X = double>
+	class Writer {
+		std::string path;
+		std::ofstream out;
+		FileHeader header{};
+		std::vector<QuantileSketch> column_sketches;
+		std::vector<std::vector<double>> cuts;
+		DMatrix<uint8_t> page;
+		size_t page_fill = 0;
+		bool writing = false, closed = false;
+		int n_threads = 1;
+	protected:
+		void start() {
+			if (cuts.empty()) {
+				if (column_sketches.empty()) throw std::runtime_error("Paged dataset: sketch the rows (or give the cuts) before appending them");
+				cuts.resize(column_sketches.size());
+				for (size_t col = 0; col < cuts.size(); col++) cuts[col] = column_sketches[col].get_cuts(std::min<size_t>(header.max_bins, MAX_PRESENT_BINS));
+				column_sketches.clear();
+			}
+			out.open(path, std::ios::binary | std::ios::trunc);
+			if (!out) throw std::runtime_error("Cannot open " + path);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			detail::pad(out);
+			header.cuts_offset = (uint64_t)out.tellp();
+			for (const auto& c : cuts) {
+				const uint64_t count = c.size();
+				out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			}
+			for (const auto& c : cuts) out.write(reinterpret_cast<const char*>(c.data()), c.size() * sizeof(double));
+			detail::pad(out);
+			header.pages_offset = (uint64_t)out.tellp();
+			writing = true;
+		}
+		// a page is written with the stride of a full one, the last one included
+		void flush_page() {
+			if (page_fill == 0) return;
+			std::vector<char> bytes(detail::round_up(header.page_rows * header.ncols), 0);
+			for (size_t col = 0; col < header.ncols; col++) {
+				std::memcpy(bytes.data() + col * page_fill, page.column_data(col), page_fill);
+			}
+			out.write(bytes.data(), bytes.size());
+			header.nrows += page_fill;
+			header.n_pages++;
+			page_fill = 0;
+		}
+	public:
+		Writer(const std::string& path, size_t ncols, size_t max_bins = MAX_BINS, size_t page_rows = PAGE_ROWS, int n_threads = 1) :
+			path{ path }, page{ page_rows, ncols } {
+			assert(max_bins >= 2 && max_bins <= MAX_BINS);
+			std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = VERSION;
+			header.byte_order = BYTE_ORDER_MARK;
+			header.max_bins = (uint32_t)max_bins;
+			header.ncols = ncols;
+			header.page_rows = page_rows;
+			this->n_threads = parallel::resolve_n_threads(n_threads);
+			column_sketches.assign(ncols, QuantileSketch(sketches::CAPACITY_PER_BIN * max_bins));
+		}
+		// cuts known beforehand (e.g. sketches::cuts of a matrix in memory): no sketching pass
+		Writer(const std::string& path, std::vector<std::vector<double>> cuts, size_t max_bins = MAX_BINS,
+			size_t page_rows = PAGE_ROWS, int n_threads = 1) : Writer(path, cuts.size(), max_bins, page_rows, n_threads) {
+			this->cuts = std::move(cuts);
+			column_sketches.clear();
+		}
+		~Writer() {
+			// an unfinished file is left as it is, without a valid header
+			if (writing && !closed) out.close();
+		}
+		// first pass: the rows go into the column sketches, w (when given) weighs them
+		void sketch(const DMatrix<X>& x) {
+			if (writing || column_sketches.empty()) throw std::runtime_error("Paged dataset: the cuts are already fixed");
+			assert(x.ncols() == header.ncols);
+			#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+			for (int col = 0; col < (int)header.ncols; col++) {
+				for (size_t i = 0; i < x.nrows(); i++) column_sketches[col].push(x(i, col));
+			}
+		}
+		void sketch(const DMatrix<X>& x, const DColumn<>& w) {
+			if (writing || column_sketches.empty()) throw std::runtime_error("Paged dataset: the cuts are already fixed");
+			assert(x.ncols() == header.ncols && w.nrows() == x.nrows());
+			#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+			for (int col = 0; col < (int)header.ncols; col++) {
+				for (size_t i = 0; i < x.nrows(); i++) column_sketches[col].push(x(i, col), w(i));
+			}
+		}
+		// second pass: the rows are quantized and written, a page at a time
+		void append(const DMatrix<X>& x) {
+			if (closed) throw std::runtime_error("Paged dataset: already closed");
+			if (x.ncols() != header.ncols) throw std::runtime_error("Paged dataset: wrong number of columns");
+			if (!writing) start();
+			for (size_t begin = 0; begin < x.nrows();) {
+				const size_t n = std::min(x.nrows() - begin, header.page_rows - page_fill);
+				#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+				for (int col = 0; col < (int)header.ncols; col++) {
+					uint8_t* codes = page.column_data(col) + page_fill;
+					for (size_t k = 0; k < n; k++) codes[k] = detail::get_bin(cuts[col], x(begin + k, col));
+				}
+				page_fill += n;
+				begin += n;
+				if (page_fill == header.page_rows) flush_page();
+			}
+			if (!out) throw std::runtime_error("Cannot write " + path);
+		}
+		void close() {
+			if (closed) return;
+			if (!writing) start();
+			flush_page();
+			out.seekp(0);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.close();
+			closed = true;
+			if (!out) throw std::runtime_error("Cannot write " + path);
+		}
+	};
+
+	// a matrix already in memory, cut with the parallel sketch
+	template <typename X>
+	void save(const DMatrix<X>& x, const std::string& path, size_t max_bins = MAX_BINS, size_t page_rows = PAGE_ROWS,
+		int n_threads = 1) {
+		Writer<X> writer(path, sketches::cuts(x, std::min(max_bins, MAX_PRESENT_BINS), n_threads), max_bins, page_rows, n_threads);
+		writer.append(x);
+		writer.close();
+	}
+}
+
+// the header and the cuts of a paged file, the pages themselves are read by a PageStream
+class PagedDataset {
+	std::string path;
+	paging::FileHeader header;
+	std::vector<std::vector<double>> cuts;
+	std::vector<size_t> offsets;
+public:
+	PagedDataset(const std::string& path) : path{ path } {
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if (!in) throw std::runtime_error("Cannot open " + path);
+		const uint64_t size = (uint64_t)in.tellg();
+		in.seekg(0);
+		if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) throw std::runtime_error("Not a paged dataset file");
+		if (std::memcmp(header.magic, paging::MAGIC, sizeof(paging::MAGIC)) != 0) throw std::runtime_error("Not a paged dataset file");
+		if (header.byte_order != paging::BYTE_ORDER_MARK) throw std::runtime_error("Paged dataset file written with another byte order");
+		if (header.version != paging::VERSION) throw std::runtime_error("Unsupported paged dataset file version " + std::to_string(header.version));
+		if (header.nrows == 0 || header.ncols == 0 || header.page_rows == 0
+			|| header.n_pages != (header.nrows + header.page_rows - 1) / header.page_rows
+			|| header.pages_offset > size || header.n_pages * get_page_bytes() > size - header.pages_offset) {
+			throw std::runtime_error("Paged dataset file truncated or corrupted");
+		}
+		std::vector<uint64_t> counts(header.ncols);
+		in.seekg(header.cuts_offset);
+		in.read(reinterpret_cast<char*>(counts.data()), counts.size() * sizeof(uint64_t));
+		cuts.resize(header.ncols);
+		offsets.resize(header.ncols + 1, 0);
+		for (size_t col = 0; col < header.ncols; col++) {
+			if (counts[col] >= std::min<size_t>(header.max_bins, MAX_PRESENT_BINS)) throw std::runtime_error("Paged dataset file truncated or corrupted");
+			cuts[col].resize(counts[col]);
+			in.read(reinterpret_cast<char*>(cuts[col].data()), counts[col] * sizeof(double));
+			offsets[col + 1] = offsets[col] + get_n_bins(col);
+		}
+		if (!in) throw std::runtime_error("Paged dataset file truncated or corrupted");
+	}
+	//
+	size_t nrows() const {
+		return header.nrows;
+	}
+	size_t ncols() const {
+		return header.ncols;
+	}
+	const std::string& get_path() const {
+		return path;
+	}
+	size_t get_n_pages() const {
+		return header.n_pages;
+	}
+	size_t get_page_rows() const {
+		return header.page_rows;
+	}
+	// bytes between two pages, all of them read in full
+	size_t get_page_bytes() const {
+		return paging::detail::round_up(header.page_rows * header.ncols);
+	}
+	size_t get_page_offset(size_t p) const {
+		return header.pages_offset + p * get_page_bytes();
+	}
+	size_t get_max_bins() const {
+		return header.max_bins;
+	}
+	// the bins, as in BinMatrix
+	inline size_t get_n_bins(size_t col) const {
+		return cuts[col].size() + 2;
+	}
+	inline size_t get_missing_bin(size_t col) const {
+		return cuts[col].size() + 1;
+	}
+	inline const std::vector<double>& get_cuts(size_t col) const {
+		return cuts[col];
+	}
+	inline double get_threshold(size_t col, size_t b) const {
+		if (b == 0) return -INFINITY;
+		return cuts[col][b - 1];
+	}
+	inline size_t get_offset(size_t col) const {
+		return offsets[col];
+	}
+	inline size_t get_total_bins() const {
+		return offsets.back();
+	}
+	// first present bin on the right of a split threshold: one of the cuts, or below all of them
+	// when the split separates the missing values from the others
+	inline size_t get_split_bin(size_t col, double threshold) const {
+		const auto& c = cuts[col];
+		return std::upper_bound(c.begin(), c.end(), threshold) - c.begin();
+	}
+};
+
+// the pages of a paged file in order, read ahead by a background thread into a ring of n_buffers
+// buffers: the reads overlap the work on the pages already there, and the memory stays n_buffers pages
+// a page handed out by next() stays valid until the following call
+class PageStream {
+public:
+	struct Page {
+		const uint8_t* codes = nullptr;
+		size_t first_row = 0, nrows = 0;
+		// bin codes of a column for the rows [first_row, first_row + nrows)
+		inline const uint8_t* column(size_t col) const {
+			return codes + col * nrows;
+		}
+	};
+private:
+	const PagedDataset& data;
+	std::vector<std::vector<uint8_t>> buffers;
+	std::mutex mutex;
+	std::condition_variable changed;
+	// pages read so far, and handed back by the consumer
+	size_t n_read = 0, n_released = 0;
+	bool holding = false, stopping = false;
+	std::exception_ptr error;
+	std::thread reader;
+protected:
+	void read_pages() {
+		try {
+			std::ifstream in(data.get_path(), std::ios::binary);
+			if (!in) throw std::runtime_error("Cannot open " + data.get_path());
+			for (size_t p = 0; p < data.get_n_pages(); p++) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					changed.wait(lock, [&] { return stopping || n_read - n_released < buffers.size(); });
+					if (stopping) return;
+				}
+				std::vector<uint8_t>& buffer = buffers[p % buffers.size()];
+				in.seekg(data.get_page_offset(p));
+				if (!in.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) {
+					throw std::runtime_error("Cannot read " + data.get_path());
+				}
+				// the codes index the histograms: one past the missing bin is a corrupted file
+				const size_t page_nrows = std::min(data.get_page_rows(), data.nrows() - p * data.get_page_rows());
+				size_t n_bad = 0;
+				for (size_t col = 0; col < data.ncols(); col++) {
+					const uint8_t* codes = buffer.data() + col * page_nrows;
+					const size_t missing_bin = data.get_missing_bin(col);
+					for (size_t r = 0; r < page_nrows; r++) n_bad += codes[r] > missing_bin;
+				}
+				if (n_bad > 0) throw std::runtime_error("Paged dataset file truncated or corrupted");
+				std::lock_guard<std::mutex> lock(mutex);
+				n_read++;
+				changed.notify_all();
+			}
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			error = std::current_exception();
+			changed.notify_all();
+		}
+	}
+public:
+	PageStream(const PagedDataset& data, size_t n_buffers = 2) : data{ data } {
+		buffers.assign(std::max<size_t>(1, n_buffers), std::vector<uint8_t>(data.get_page_bytes()));
+		reader = std::thread(&PageStream::read_pages, this);
+	}
+	PageStream(const PageStream&) = delete;
+	PageStream& operator=(const PageStream&) = delete;
+	~PageStream() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			changed.notify_all();
+		}
+		reader.join();
+	}
+	// hands the previous page back and waits for the next one; false after the last page
+	bool next(Page& page) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (holding) {
+			n_released++;
+			holding = false;
+			changed.notify_all();
+		}
+		if (n_released == data.get_n_pages()) return false;
+		changed.wait(lock, [&] { return error || n_read > n_released; });
+		if (n_read == n_released) std::rethrow_exception(error);
+		const size_t p = n_released;
+		page.codes = buffers[p % buffers.size()].data();
+		page.first_row = p * data.get_page_rows();
+		page.nrows = std::min(data.get_page_rows(), data.nrows() - page.first_row);
+		holding = true;
+		return true;
+	}
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+#include <uboost2/data.h>
+#include <uboost2/parallel.h>
+
+// weighted quantile summary in the Greenwald-Khanna style (the weighted variant of XGBoost's WQSummary):
+// a sorted list of values, each with the bounds [rmin, rmax] of the weight at or below it and its own weight
+// values are pushed into a buffer that is summarized when full; summaries of 2^l buffers are combined
+// level by level and pruned back to `capacity` entries, so a column of any length takes
+// O(capacity * log(n / capacity)) memory; two sketches merge into one (e.g. one per row chunk)
+// the rank error grows with the number of prunes a value went through, ~ levels / capacity of the weight;
+// as long as nothing was pruned the summary is exact
+class QuantileSketch {
+public:
+	struct Entry {
+		double value;
+		// weight strictly below value, weight at or below value, weight of value itself
+		double rmin, rmax, w;
+		inline double rmin_next() const {
+			return rmin + w;
+		}
+		inline double rmax_prev() const {
+			return rmax - w;
+		}
+	};
+	using Summary = std::vector<Entry>;
+private:
+	size_t capacity = 4096;
+	std::vector<std::pair<double, double>> buffer;
+	// levels[l] summarizes 2^l buffers, or is empty
+	std::vector<Summary> levels;
+protected:
+	// exact summary of raw (value, weight) pairs, equal values in one entry
+	static Summary summarize(std::vector<std::pair<double, double>>& values) {
+		std::sort(values.begin(), values.end());
+		Summary out;
+		double below = 0.0;
+		for (const auto& [value, w] : values) {
+			if (!out.empty() && out.back().value == value) {
+				out.back().rmax += w;
+				out.back().w += w;
+			}
+			else out.push_back(Entry{ value, below, below + w, w });
+			below += w;
+		}
+		return out;
+	}
+	// summary of the union of two summaries
+	static Summary combine(const Summary& a, const Summary& b) {
+		if (a.empty()) return b;
+		if (b.empty()) return a;
+		Summary out;
+		out.reserve(a.size() + b.size());
+		size_t i = 0, j = 0;
+		// rmin of the next entry of each side: what that side has at or below the current value
+		double a_below = 0.0, b_below = 0.0;
+		while (i < a.size() && j < b.size()) {
+			if (a[i].value == b[j].value) {
+				out.push_back(Entry{ a[i].value, a[i].rmin + b[j].rmin, a[i].rmax + b[j].rmax, a[i].w + b[j].w });
+				a_below = a[i++].rmin_next();
+				b_below = b[j++].rmin_next();
+			}
+			else if (a[i].value < b[j].value) {
+				out.push_back(Entry{ a[i].value, a[i].rmin + b_below, a[i].rmax + b[j].rmax_prev(), a[i].w });
+				a_below = a[i++].rmin_next();
+			}
+			else {
+				out.push_back(Entry{ b[j].value, b[j].rmin + a_below, b[j].rmax + a[i].rmax_prev(), b[j].w });
+				b_below = b[j++].rmin_next();
+			}
+		}
+		for (; i < a.size(); i++) out.push_back(Entry{ a[i].value, a[i].rmin + b_below, a[i].rmax + b.back().rmax, a[i].w });
+		for (; j < b.size(); j++) out.push_back(Entry{ b[j].value, b[j].rmin + a_below, b[j].rmax + a.back().rmax, b[j].w });
+		return out;
+	}
+	// at most size entries: the first, the last, and the ones closest to size - 2 evenly spaced ranks
+	static Summary prune(const Summary& src, size_t size) {
+		if (src.size() <= size) return src;
+		Summary out;
+		out.reserve(size);
+		const double begin = src.front().rmax, range = src.back().rmin - src.front().rmax;
+		const size_t n = size - 1;
+		out.push_back(src.front());
+		size_t i = 1, last = 0;
+		for (size_t k = 1; k < n; k++) {
+			// twice the target rank, compared with the midpoints rmin + rmax
+			const double dx2 = 2.0 * (k * range / n + begin);
+			while (i < src.size() - 1 && dx2 >= src[i + 1].rmax + src[i + 1].rmin) i++;
+			if (i == src.size() - 1) break;
+			const size_t pick = dx2 < src[i].rmin_next() + src[i + 1].rmax_prev() ? i : i + 1;
+			if (pick != last) {
+				out.push_back(src[pick]);
+				last = pick;
+			}
+		}
+		if (last != src.size() - 1) out.push_back(src.back());
+		return out;
+	}
+	// carries a summary up the levels, as in a binary counter
+	void insert(Summary summary, size_t level = 0) {
+		for (; level < levels.size() && !levels[level].empty(); level++) {
+			summary = prune(combine(levels[level], summary), capacity);
+			levels[level].clear();
+		}
+		if (level == levels.size()) levels.emplace_back();
+		levels[level] = std::move(summary);
+	}
+	void flush() {
+		if (buffer.empty()) return;
+		insert(prune(summarize(buffer), capacity));
+		buffer.clear();
+	}
+public:
+	QuantileSketch(size_t capacity = 4096) {
+		assert(capacity >= 2);
+		this->capacity = capacity;
+		buffer.reserve(capacity);
+	}
+	// missing values and rows without weight are left out, as the builders do
+	inline void push(double x, double w = 1.0) {
+		if (is_missing(x) || !(w > 0.0)) return;
+		buffer.emplace_back(x, w);
+		if (buffer.size() == capacity) flush();
+	}
+	// adds everything other has seen
+	void merge(const QuantileSketch& other) {
+		flush();
+		Summary s = other.get_summary();
+		if (!s.empty()) insert(std::move(s), levels.size() ? levels.size() - 1 : 0);
+	}
+	// all the levels in one summary of at most capacity entries
+	Summary get_summary() const {
+		Summary out;
+		if (!buffer.empty()) {
+			auto values = buffer;
+			out = summarize(values);
+		}
+		for (const Summary& s : levels) out = prune(combine(out, s), capacity);
+		return prune(out, capacity);
+	}
+	// cuts of at most max_bins bins of about equal weight, as midpoints between neighbouring values;
+	// with few distinct values (all of them kept), one bin each
+	std::vector<double> get_cuts(size_t max_bins) const {
+		const Summary s = get_summary();
+		std::vector<double> out;
+		if (s.size() <= max_bins) {
+			for (size_t k = 1; k < s.size(); k++) out.push_back(0.5 * (s[k - 1].value + s[k].value));
+			return out;
+		}
+		const double total = s.back().rmax;
+		size_t i = 0;
+		for (size_t k = 1; k < max_bins; k++) {
+			// the value the k-th quantile falls on
+			const double rank = k * total / max_bins;
+			while (i < s.size() - 1 && s[i].rmax <= rank) i++;
+			if (i == 0) continue;
+			const double cut = 0.5 * (s[i - 1].value + s[i].value);
+			if (out.empty() || cut > out.back()) out.push_back(cut);
+		}
+		return out;
+	}
+	size_t get_capacity() const {
+		return capacity;
+	}
+};
+
+namespace sketches {
+	// rows per chunk: fixed, so the cuts do not depend on the number of threads
+	constexpr size_t CHUNK_ROWS = 1 << 20;
+	// summary entries per bin
+	constexpr size_t CAPACITY_PER_BIN = 16;
+
+	// bin cuts of every column in one parallel pass over row chunks: every chunk of a column is sketched
+	// on its own, then the sketches of the column are merged pairwise, in chunk order
+	// columns go in blocks just large enough to keep the threads busy, so at most
+	// max(n_chunks, n_threads) sketches are alive at once; w null means unit weights
+	template <typename X>
+	std::vector<std::vector<double>> cuts(const DMatrix<X>& x, const DColumn<>* w, size_t max_bins, int n_threads = 1) {
+		assert(w == nullptr || w->nrows() == x.nrows());
+		n_threads = parallel::resolve_n_threads(n_threads);
+		const size_t nrows = x.nrows(), ncols = x.ncols();
+		const size_t n_chunks = std::max<size_t>(1, (nrows + CHUNK_ROWS - 1) / CHUNK_ROWS);
+		const size_t block = std::max<size_t>(1, (n_threads + n_chunks - 1) / n_chunks);
+		const size_t capacity = CAPACITY_PER_BIN * max_bins;
+		std::vector<std::vector<double>> out(ncols);
+		std::vector<QuantileSketch> sketches;
+		for (size_t first = 0; first < ncols; first += block) {
+			const size_t n_cols = std::min(block, ncols - first);
+			// sketch k covers chunk k % n_chunks of column first + k / n_chunks
+			sketches.assign(n_cols * n_chunks, QuantileSketch(capacity));
+			#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+			for (int k = 0; k < (int)sketches.size(); k++) {
+				const size_t col = first + k / n_chunks, begin = (k % n_chunks) * CHUNK_ROWS;
+				const size_t end = std::min(nrows, begin + CHUNK_ROWS);
+				QuantileSketch& sketch = sketches[k];
+				if (w) for (size_t i = begin; i < end; i++) sketch.push(x(i, col), (*w)(i));
+				else for (size_t i = begin; i < end; i++) sketch.push(x(i, col));
+			}
+			for (size_t step = 1; step < n_chunks; step *= 2) {
+				#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+				for (int k = 0; k < (int)sketches.size(); k++) {
+					const size_t c = k % n_chunks;
+					if (c % (2 * step) == 0 && c + step < n_chunks) sketches[k].merge(sketches[k + step]);
+				}
+			}
+			#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+			for (int j = 0; j < (int)n_cols; j++) out[first + j] = sketches[j * n_chunks].get_cuts(max_bins);
+		}
+		return out;
+	}
+	template <typename X>
+	std::vector<std::vector<double>> cuts(const DMatrix<X>& x, const DColumn<>& w, size_t max_bins, int n_threads = 1) {
+		return cuts(x, &w, max_bins, n_threads);
+	}
+	template <typename X>
+	std::vector<std::vector<double>> cuts(const DMatrix<X>& x, size_t max_bins, int n_threads = 1) {
+		return cuts(x, nullptr, max_bins, n_threads);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <limits>
+#include <cassert>
+
+#include <uboost2/data.h>
+#include <uboost2/parallel.h>
+
+// columnar presorted index: for every column the row ids ordered by increasing feature value
+// the values and the row statistics are read through it, so a cell costs 4 bytes
+// missing values (NaN) are sorted last, the last get_n_missing(col) rows of a column
+class SortedIndex : public DMatrix<uint32_t> {
+	std::vector<size_t> n_missing;
+public:
+	template <typename X>
+	SortedIndex(const DMatrix<X>& x, int n_threads = 1) : DMatrix<uint32_t>{ x.nrows(), x.ncols() }, n_missing(x.ncols(), 0) {
+		assert(x.nrows() <= std::numeric_limits<uint32_t>::max());
+		n_threads = parallel::resolve_n_threads(n_threads);
+		#pragma omp parallel num_threads(n_threads)
+		{
+			std::vector<std::pair<X, uint32_t>> buffer(m_nrows);
+			#pragma omp for schedule(dynamic)
+			for (int col = 0; col < (int)m_ncols; col++) {
+				const X* xcol = x.column_data(col);
+				size_t missing = 0;
+				for (size_t i = 0; i < m_nrows; i++) {
+					buffer[i] = { xcol[i], (uint32_t)i };
+					missing += is_missing(xcol[i]);
+				}
+				std::sort(buffer.begin(), buffer.end(),
+					[](const std::pair<X, uint32_t>& a, const std::pair<X, uint32_t>& b) {
+						if (is_missing(b.first)) return !is_missing(a.first);
+						return a.first < b.first;
+					}
+				);
+				uint32_t* order = column_data(col);
+				for (size_t k = 0; k < m_nrows; k++) order[k] = buffer[k].second;
+				n_missing[col] = missing;
+			}
+		}
+	}
+	// prepared permutations (e.g. mapped from a dataset file), used as they are
+	SortedIndex(const DMatrix<uint32_t>& order, std::vector<size_t> n_missing) :
+		DMatrix<uint32_t>{ order }, n_missing{ std::move(n_missing) } {
+		assert(this->n_missing.size() == m_ncols);
+	}
+	inline size_t get_n_missing(size_t col) const {
+		return n_missing[col];
+	}
+};
@@ -5,6 +5,8 @@ public:
 	bool succesful;
 	size_t column;
 	double threshold;
+	// where the missing values go (NaN, or absent from a sparse row)
+	bool default_left = false;
 	size_t i;
 	//
 	double criterion_gain;
@@ -19,6 +19,22 @@ public:
 	virtual const Split build_split(const GHEntry& e) = 0;
 };
 
+class UnaryHistSplitter {
+public:
+	UnaryHistSplitter() {}
+	virtual void add(const Bin& b) = 0;
+	virtual void start_splitting(size_t col = 0) = 0;
+	virtual const Split build_split(const Bin& b, double threshold) = 0;
+};
+
+class BinaryHistSplitter {
+public:
+	BinaryHistSplitter() {}
+	virtual void add(const GHBin& b) = 0;
+	virtual void start_splitting(size_t col = 0) = 0;
+	virtual const Split build_split(const GHBin& b, double threshold) = 0;
+};
+
 //
 
 class MSESplitter : public UnarySplitter {
@@ -36,6 +52,7 @@ class MSESplitter : public UnarySplitter {
 	bool first;
 	double previous_x;
 	double p_criterion;
+	bool default_left = false;
 public:
 	MSESplitter(size_t min_samples_leaf = 1, double min_weight_leaf = 0.0) {
 		this->min_samples_leaf = min_samples_leaf;
@@ -44,11 +61,15 @@ public:
 		s2 = 0.0;
 		n = 0;
 		w = 0.0;
+		start_splitting(0);
 	}
 	void add(const Entry& e) override {
-		s += e.y * e.w;
-		s2 += e.y * e.y * e.w;
-		w += e.w;
+		add(e.y, e.w);
+	}
+	inline void add(double y, double w) {
+		s += y * w;
+		s2 += y * y * w;
+		this->w += w;
 		n++;
 	}
 	void start_splitting(size_t col = 0) override {
@@ -66,21 +87,41 @@ public:
 		p_criterion = s * s / w - s2;
 		first = true;
 		previous_x = NAN;
+		default_left = false;
+	}
+	// second scan of a column with missing values: they start on the left, the first candidate
+	// sends every present value right
+	void start_splitting(size_t col, const Bin& missing) {
+		start_splitting(col);
+		sl += missing.s;
+		sr -= missing.s;
+		s2l += missing.s2;
+		s2r -= missing.s2;
+		nl += missing.n;
+		nr -= missing.n;
+		wl += missing.w;
+		wr -= missing.w;
+		previous_x = -INFINITY;
+		default_left = true;
 	}
 	inline const Split build_split(const Entry& e) override {
+		return build_split(e.i, e.x, e.y, e.w);
+	}
+	inline const Split build_split(size_t i, double x, double y, double w) {
 		Split split = Split::build_unsuccessful_split();
 		split.succesful = true;
-		double delta_x = e.x - previous_x;
+		double delta_x = x - previous_x;
 		
 		if (nl < min_samples_leaf || nr < min_samples_leaf) split.succesful = false;
 		if (wl < min_weight_leaf || wr < min_weight_leaf) split.succesful = false;
 
-		if (delta_x < 1e-6) split.succesful = false;
+		if (delta_x < 1e-6 || is_missing(x)) split.succesful = false;
 
 		if (split.succesful) {
 			split.column = column;
-			split.threshold = 0.5 * (e.x + previous_x);
-			split.i = e.i;
+			split.threshold = 0.5 * (x + previous_x);
+			split.default_left = default_left;
+			split.i = i;
 			split.l_criterion = sl * sl / wl - s2l;
 			split.r_criterion = sr * sr / wr - s2r;
 			split.p_criterion = this->p_criterion;
@@ -90,22 +131,22 @@ public:
 			split.p_n = n;
 			split.l_value = sl / wl;
 			split.r_value = sr / wr;
-			split.p_value = s / w;
+			split.p_value = s / this->w;
 			split.l_w = wl;
 			split.r_w = wr;
-			split.p_w = w;
+			split.p_w = this->w;
 		}
 
 		// update statistics for next split
-		sl += e.y * e.w;
-		sr -= e.y * e.w;
-		s2l += e.y * e.y * e.w;
-		s2r -= e.y * e.y * e.w;
+		sl += y * w;
+		sr -= y * w;
+		s2l += y * y * w;
+		s2r -= y * y * w;
 		nl++;
 		nr--;
-		wl += e.w;
-		wr -= e.w;
-		previous_x = e.x;
+		wl += w;
+		wr -= w;
+		previous_x = x;
 
 		return split;
 	}
@@ -123,20 +164,26 @@ class GHSplitter : public BinarySplitter {
 	double min_weight_leaf = 0.0;
 	double previous_x;
 	double p_criterion, p_value;
+	bool default_left = false;
 public:
-	GHSplitter(size_t min_samples_leaf = 1, double min_weight_leaf = 0.0) {
+	GHSplitter(size_t min_samples_leaf = 1, double min_weight_leaf = 0.0, double reg_lambda = 1.0) {
 		this->min_samples_leaf = min_samples_leaf;
 		this->min_weight_leaf = min_weight_leaf;
+		this->reg_lambda = reg_lambda;
 		G = 0.0;
 		H = 0.0;
 		n = 0;
 		w = 0.0;
+		start_splitting(0);
 	}
 	void add(const GHEntry& e) {
-		G += e.g * e.w;
-		H += e.h * e.w;
+		add(e.g, e.h, e.w);
+	}
+	inline void add(double g, double h, double w) {
+		G += g * w;
+		H += h * w;
 		n++;
-		w += e.w;
+		this->w += w;
 	}
 	void start_splitting(size_t col = 0) {
 		column = col;
@@ -153,11 +200,47 @@ public:
 		p_criterion = G * G / (reg_lambda + H);
 		p_value = G / (reg_lambda + H);
 		previous_x = NAN;
+		default_left = false;
+	}
+	// second scan of a column with a default bucket (missing values, or the entries absent from a
+	// sparse column): it starts on the left, the first candidate sends every present value right
+	void start_splitting(size_t col, const GHBin& defaults) {
+		start_splitting(col);
+		GL += defaults.g;
+		GR -= defaults.g;
+		HL += defaults.h;
+		HR -= defaults.h;
+		nl += defaults.n;
+		nr -= defaults.n;
+		wl += defaults.w;
+		wr -= defaults.w;
+		previous_x = -INFINITY;
+		default_left = true;
+	}
+	// totals of the rows moved to the left so far, g and h already weighted
+	GHBin left_stats() const {
+		GHBin b;
+		b.g = GL;
+		b.h = HL;
+		b.w = wl;
+		b.n = nl;
+		return b;
+	}
+	GHBin total_stats() const {
+		GHBin b;
+		b.g = G;
+		b.h = H;
+		b.w = w;
+		b.n = n;
+		return b;
 	}
 	inline const Split build_split(const GHEntry& e) {
+		return build_split(e.i, e.x, e.g, e.h, e.w);
+	}
+	inline const Split build_split(size_t i, double x, double g, double h, double w) {
 		Split split = Split::build_unsuccessful_split();
 		split.succesful = true;
-		double delta_x = e.x - previous_x;
+		double delta_x = x - previous_x;
 
 		if (nl < this->min_samples_leaf || nr < this->min_samples_leaf) {
 			split.succesful = false;
@@ -165,14 +248,15 @@ public:
 		if (wl < min_weight_leaf || wr < min_weight_leaf) {
 			split.succesful = false;
 		}
-		if (delta_x < 1e-6) {
+		if (delta_x < 1e-6 || is_missing(x)) {
 			split.succesful = false;
 		}
 
 		if (split.succesful) {
 			split.column = column;
-			split.threshold = 0.5 * (e.x + previous_x);
-			split.i = e.i;
+			split.threshold = 0.5 * (x + previous_x);
+			split.default_left = default_left;
+			split.i = i;
 			split.l_criterion = GL * GL / (reg_lambda + HL);
 			split.r_criterion = GR * GR / (reg_lambda + HR);
 			split.p_criterion = this->p_criterion;
@@ -185,20 +269,237 @@ public:
 			split.p_value = p_value;
 			split.l_w = wl;
 			split.r_w = wr;
-			split.p_w = w;
+			split.p_w = this->w;
 		}
 
 		// update statistics for next split 
-		GL += e.g * e.w;
-		GR -= e.g * e.w;
-		HL += e.h * e.w;
-		HR -= e.h * e.w;
+		GL += g * w;
+		GR -= g * w;
+		HL += h * w;
+		HR -= h * w;
 		nl++;
 		nr--;
-		wl += e.w;
-		wr -= e.w;
-		previous_x = e.x;
+		wl += w;
+		wr -= w;
+		previous_x = x;
 
 		return split;
 	}
 };
+
+
+
+// histogram splitters: bins are scanned in increasing order, a candidate split
+// sends the bins already seen to the left and the current one and after to the right
+// the missing bin is not scanned: it stays on the right, or starts on the left in a second scan
+
+class MSEHistSplitter : public UnaryHistSplitter {
+	size_t min_samples_leaf = 1;
+	double min_weight_leaf = 0.0;
+	size_t column;
+	size_t b;
+	//
+	double s, s2, w;
+	size_t n;
+	double sl, s2l, wl;
+	size_t nl;
+	double sr, s2r, wr;
+	size_t nr;
+	//
+	double p_criterion;
+	bool default_left = false;
+public:
+	MSEHistSplitter(size_t min_samples_leaf = 1, double min_weight_leaf = 0.0) {
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_weight_leaf = min_weight_leaf;
+		s = 0.0;
+		s2 = 0.0;
+		n = 0;
+		w = 0.0;
+		start_splitting(0);
+	}
+	void add(const Bin& bin) override {
+		s += bin.s;
+		s2 += bin.s2;
+		w += bin.w;
+		n += bin.n;
+	}
+	void start_splitting(size_t col = 0) override {
+		column = col;
+		b = 0;
+		//
+		sl = 0.0;
+		s2l = 0.0;
+		nl = 0;
+		wl = 0.0;
+		sr = s;
+		s2r = s2;
+		nr = n;
+		wr = w;
+		//
+		p_criterion = s * s / w - s2;
+		default_left = false;
+	}
+	// second scan of a column with missing values: their bin starts on the left
+	void start_splitting(size_t col, const Bin& missing) {
+		start_splitting(col);
+		sl += missing.s;
+		sr -= missing.s;
+		s2l += missing.s2;
+		s2r -= missing.s2;
+		nl += missing.n;
+		nr -= missing.n;
+		wl += missing.w;
+		wr -= missing.w;
+		default_left = true;
+	}
+	inline const Split build_split(const Bin& bin, double threshold) override {
+		Split split = Split::build_unsuccessful_split();
+		split.succesful = true;
+
+		if (nl < min_samples_leaf || nr < min_samples_leaf) split.succesful = false;
+		if (wl < min_weight_leaf || wr < min_weight_leaf) split.succesful = false;
+		if (bin.n == 0) split.succesful = false;
+
+		if (split.succesful) {
+			split.column = column;
+			split.threshold = threshold;
+			split.default_left = default_left;
+			split.i = b;
+			split.l_criterion = sl * sl / wl - s2l;
+			split.r_criterion = sr * sr / wr - s2r;
+			split.p_criterion = this->p_criterion;
+			split.criterion_gain = split.l_criterion + split.r_criterion - split.p_criterion;
+			split.l_n = nl;
+			split.r_n = nr;
+			split.p_n = n;
+			split.l_value = sl / wl;
+			split.r_value = sr / wr;
+			split.p_value = s / w;
+			split.l_w = wl;
+			split.r_w = wr;
+			split.p_w = w;
+		}
+
+		// update statistics for next split
+		sl += bin.s;
+		sr -= bin.s;
+		s2l += bin.s2;
+		s2r -= bin.s2;
+		nl += bin.n;
+		nr -= bin.n;
+		wl += bin.w;
+		wr -= bin.w;
+		b++;
+
+		return split;
+	}
+};
+
+
+class GHHistSplitter : public BinaryHistSplitter {
+	double G, H;
+	double GL, HL, GR, HR;
+	double w, wl, wr;
+	double reg_lambda = 1.0;
+	size_t n, nl, nr;
+	size_t column, min_samples_leaf;
+	size_t b;
+	double min_weight_leaf = 0.0;
+	double p_criterion, p_value;
+	bool default_left = false;
+public:
+	GHHistSplitter(size_t min_samples_leaf = 1, double min_weight_leaf = 0.0, double reg_lambda = 1.0) {
+		this->min_samples_leaf = min_samples_leaf;
+		this->min_weight_leaf = min_weight_leaf;
+		this->reg_lambda = reg_lambda;
+		G = 0.0;
+		H = 0.0;
+		n = 0;
+		w = 0.0;
+		start_splitting(0);
+	}
+	void add(const GHBin& bin) override {
+		G += bin.g;
+		H += bin.h;
+		n += bin.n;
+		w += bin.w;
+	}
+	void start_splitting(size_t col = 0) override {
+		column = col;
+		b = 0;
+		//
+		GL = 0.0;
+		GR = G;
+		HL = 0.0;
+		HR = H;
+		nl = 0;
+		nr = n;
+		wl = 0.0;
+		wr = w;
+		//
+		p_criterion = G * G / (reg_lambda + H);
+		p_value = G / (reg_lambda + H);
+		default_left = false;
+	}
+	// second scan of a column with missing values: their bin starts on the left
+	void start_splitting(size_t col, const GHBin& missing) {
+		start_splitting(col);
+		GL += missing.g;
+		GR -= missing.g;
+		HL += missing.h;
+		HR -= missing.h;
+		nl += missing.n;
+		nr -= missing.n;
+		wl += missing.w;
+		wr -= missing.w;
+		default_left = true;
+	}
+	inline const Split build_split(const GHBin& bin, double threshold) override {
+		Split split = Split::build_unsuccessful_split();
+		split.succesful = true;
+
+		if (nl < this->min_samples_leaf || nr < this->min_samples_leaf) {
+			split.succesful = false;
+		}
+		if (wl < min_weight_leaf || wr < min_weight_leaf) {
+			split.succesful = false;
+		}
+		if (bin.n == 0) {
+			split.succesful = false;
+		}
+
+		if (split.succesful) {
+			split.column = column;
+			split.threshold = threshold;
+			split.default_left = default_left;
+			split.i = b;
+			split.l_criterion = GL * GL / (reg_lambda + HL);
+			split.r_criterion = GR * GR / (reg_lambda + HR);
+			split.p_criterion = this->p_criterion;
+			split.criterion_gain = split.l_criterion + split.r_criterion - split.p_criterion;
+			split.l_n = nl;
+			split.r_n = nr;
+			split.p_n = n;
+			split.l_value = GL / (reg_lambda + HL);
+			split.r_value = GR / (reg_lambda + HR);
+			split.p_value = p_value;
+			split.l_w = wl;
+			split.r_w = wr;
+			split.p_w = w;
+		}
+
+		// update statistics for next split
+		GL += bin.g;
+		GR -= bin.g;
+		HL += bin.h;
+		HR -= bin.h;
+		nl += bin.n;
+		nr -= bin.n;
+		wl += bin.w;
+		wr -= bin.w;
+		b++;
+
+		return split;
+	}
+};
\ No newline at end of file
@@ -2,10 +2,13 @@
 
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <stdexcept>
 #include <cassert>
 
 #include <uboost2/tree/treestruct.h>
 #include <uboost2/data.h>
+#include <uboost2/sparse.h>
 
 constexpr size_t NOCOLUMN = std::numeric_limits<size_t>::max();
 
@@ -14,6 +17,8 @@ struct TreeNode {
 	double value = 0.0;
 	size_t column = NOCOLUMN;
 	double threshold = NAN;
+	// direction of the missing values (NaN, or absent from a sparse row)
+	bool default_left = false;
 	// stats
 	double criterion = NAN;
 	double gain = NAN;
@@ -48,41 +53,73 @@ public:
 	inline TreeNode& get_node(size_t nid) {
 		return nodes[nid];
 	}
-	//
-	inline size_t predict_leaf(const DMatrix<>& x, size_t i) const {
-		const auto& xi = DRow<>(x, i);
+	// thresholds are doubles, the features of any precision are compared after widening
+	template <typename X>
+	inline size_t predict_leaf(const DMatrix<X>& x, size_t i) const {
+		const auto& xi = DRow<X>(x, i);
 		return this->predict_leaf(xi);
 	}
-	inline size_t predict_leaf(const DRow<>& xi) const {
+	template <typename X>
+	inline size_t predict_leaf(const DRow<X>& xi) const {
 		size_t nid{ trees::ROOTID };
 		while (!nodes[nid].is_leaf) {
-			auto xicol = xi(nodes[nid].column);
-			if (xicol == NAN) break;
-			if (xi(nodes[nid].column) >= nodes[nid].threshold) nid = trees::right_child(nid);
-			else nid = trees::left_child(nid);
+			const TreeNode& node = nodes[nid];
+			const X xicol = xi(node.column);
+			const bool left = is_missing(xicol) ? node.default_left : xicol < node.threshold;
+			nid = left ? trees::left_child(nid) : trees::right_child(nid);
+		}
+		return nid;
+	}
+	inline size_t predict_leaf(const CSRMatrix<>& x, size_t i) const {
+		size_t nid{ trees::ROOTID };
+		while (!nodes[nid].is_leaf) {
+			const TreeNode& node = nodes[nid];
+			const double* xij = x.find(i, node.column);
+			const bool left = xij == nullptr ? node.default_left : *xij < node.threshold;
+			nid = left ? trees::left_child(nid) : trees::right_child(nid);
 		}
 		return nid;
 	}
 	//
-	inline double predict_value_row(const DMatrix<>& x, size_t i) const {
+	template <typename X>
+	inline double predict_value_row(const DMatrix<X>& x, size_t i) const {
 		return nodes[predict_leaf(x, i)].value;
 	}
-	inline double predict_value_row(const DRow<>& xi) const {
+	template <typename X>
+	inline double predict_value_row(const DRow<X>& xi) const {
 		return nodes[predict_leaf(xi)].value;
 	}
 	//
-	DColumn<> predict_value(const DMatrix<>& x) const {
+	template <typename X>
+	DColumn<> predict_value(const DMatrix<X>& x) const {
+		if (x.ncols() < get_n_features()) throw std::runtime_error("Matrix has fewer columns than the tree splits on");
 		DColumn<> out(x.nrows());
 		for (size_t i = 0; i < x.nrows(); i++) {
 			out(i) = this->predict_value_row(x, i);
 		}
 		return out;
 	}
+	DColumn<> predict_value(const CSRMatrix<>& x) const {
+		DColumn<> out(x.nrows());
+		for (size_t i = 0; i < x.nrows(); i++) {
+			out(i) = nodes[predict_leaf(x, i)].value;
+		}
+		return out;
+	}
+	// column-compressed input is transposed once, rows are walked in CSR
+	DColumn<> predict_value(const CSCMatrix<>& x) const {
+		return predict_value(sparse::to_csr(x));
+	}
 	//
 	size_t get_n_leaves(size_t nid = trees::ROOTID) const {
 		if (nodes[nid].is_leaf) return 1;
 		return get_n_leaves(trees::left_child(nid)) + get_n_leaves(trees::right_child(nid));
 	}
+	// columns a matrix needs for the splits of the tree
+	size_t get_n_features(size_t nid = trees::ROOTID) const {
+		if (nodes[nid].is_leaf) return 0;
+		return std::max({ nodes[nid].column + 1, get_n_features(trees::left_child(nid)), get_n_features(trees::right_child(nid)) });
+	}
 	size_t get_max_depth() const {
 		return max_depth;
 	}
@@ -92,10 +129,10 @@ public:
 		auto node = nodes[nid];
 		for (size_t i = 0; i < depth; i++) std::printf("  ");
 
-		std::printf("[%.3d|%.2d]", nid, depth);
+		std::printf("[%.3zu|%.2zu]", nid, depth);
 
 		if (node.is_leaf) {
-			std::printf(" %d - %.2f - %.4f\n", node.n, node.criterion, node.value);
+			std::printf(" %zu - %.2f - %.4f\n", node.n, node.criterion, node.value);
 		}
 		else {
 			printf("\n");
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <cmath>
+
 namespace trees {
 
 	constexpr size_t ROOTID = 0;
@@ -23,4 +26,12 @@ namespace trees {
 	inline size_t right_child(size_t idx) {
 		return left_child(idx) + 1;
 	}
+
+	inline size_t parent(size_t idx) {
+		return (idx - 1) / 2;
+	}
+
+	inline size_t sibling(size_t idx) {
+		return (idx % 2 == 1) ? idx + 1 : idx - 1;
+	}
 }
@@ -5,8 +5,10 @@ from sklearn import model_selection
 
 from .base import GeneralBoosting, log_time
 from ..losses import Loss, get_loss
-from ..optimizers import Optimizer, get_optimizer
-from ..estimators.tree import DecisionTreeRegressor
+from ..optimizers import Optimizer, GradientDescentOptimizer, NewtonOptimizer, get_optimizer
+from ..core import _core
+from ..estimators.base import BaseEstimator
+from ..estimators.tree import DecisionTreeRegressor, is_sparse, maybe_numpyToDataset, maybe_numpyToDMatrix
 from ..transformers import DummyTransformer
 from ..utils import logit, sigmoid
 
@@ -20,9 +22,9 @@ class GradientBoosting(GeneralBoosting):
                  max_delta_step: float = 1e6,
                  dropout_rate: float = 0.0,
                  base_score: typing.Union[str, float] = 'auto',
-                 optimizer: typing.Union[str, Optimizer] = 'gd', loss: str = 'mse'):
+                 optimizer: typing.Union[str, Optimizer] = 'gd', loss: str = 'mse', n_threads: int = 1):
         super(GradientBoosting, self).__init__(n_estimators=n_estimators)
-        self.build_estimator = lambda: DecisionTreeRegressor(max_depth=max_depth)
+        self.build_estimator = lambda: DecisionTreeRegressor(max_depth=max_depth, n_threads=n_threads)
         self.build_transformer = lambda: DummyTransformer()
         self.learning_rate = learning_rate
         self.max_delta_step: float = max_delta_step
@@ -31,6 +33,7 @@ class GradientBoosting(GeneralBoosting):
         self.base_score: typing.Union[str, float] = base_score
         self.optimizer: Optimizer = get_optimizer(optimizer)() if isinstance(optimizer, str) else optimizer
         self.loss: Loss = get_loss(loss)()
+        self.n_threads: int = n_threads
         #
         if self.dropout_rate <= 0.0:
             self._training_pred_method = 2
@@ -54,6 +57,12 @@ class GradientBoosting(GeneralBoosting):
             self.baseline = np.zeros((1, 1)) + self.base_score
         self.predictions = list()
         self.total_prediction = self.baseline + np.zeros((self.x.shape[0], 1))
+        # sorted/quantized once, only the gradients change between rounds
+        self._dataset = None
+        # native copy of the trees for batched prediction, single output only
+        self._ensemble = None
+        if self.baseline.size == 1 and not is_sparse(x):
+            self._ensemble = _core.Ensemble(float(self.baseline.ravel()[0]), float(self.max_delta_step))
         pass
 
     def _fit_learner(self):
@@ -100,27 +109,45 @@ class GradientBoosting(GeneralBoosting):
         # train
         estimator = self.build_estimator()
         lr = float(self.learning_rate)
-        if hasattr(estimator, 'fit_gh'):
+        data = z
+        if isinstance(transformer, DummyTransformer) and hasattr(estimator, 'n_threads') and not is_sparse(z):
+            if self._dataset is None:
+                self._dataset = maybe_numpyToDataset(z, estimator.n_threads)
+                if hasattr(estimator, 'fit_gh') and y.shape[1] == 1:
+                    self._dataset.set_y(_core.numpyToDColumn(np.ravel(y).astype(np.float64)))
+            data = self._dataset
+        subsample = self.subsample is not None and self.subsample < 1.0
+        if subsample and isinstance(data, (_core.Dataset, _core.DatasetF32)):
+            # rows out of the subsample get weight 0 and are skipped by the builder: the sorted dataset is
+            # reused as it is, nothing is copied or sorted again
+            data = data.with_w(_core.numpyToDColumn(self._subsample_weights(z.shape[0])))
+            subsample = False
+        if hasattr(estimator, 'fit_gh') and self._native_gradients(data, y):
+            # fused kernel: g and h written in one pass straight into the dataset
+            newton = type(self.optimizer) is not GradientDescentOptimizer
+            data.update_gradients(self.loss._native, _core.numpyToDColumn(np.ravel(p)), -lr, newton)
+            estimator.fit_gh(data, None, None)
+        elif hasattr(estimator, 'fit_gh'):
             g, h = self.optimizer.compute_grad_and_hess(self.loss, y, p)
             g *= -lr
 
-            if self.subsample is not None and self.subsample < 1.0:
+            if subsample:
                 idxT = np.arange(z.shape[0])
                 idxT, idxV = model_selection.train_test_split(idxT, test_size=1 - self.subsample)
                 estimator.fit_gh(z[idxT], g[idxT], h[idxT])
             else:
-                estimator.fit_gh(z, g, h)
+                estimator.fit_gh(data, g, h)
                 pass
         else:
             g = self.optimizer.compute_step(self.loss, y, p)
             g *= lr
 
-            if self.subsample is not None and self.subsample < 1.0:
+            if subsample:
                 idxT = np.arange(z.shape[0])
                 idxT, idxV = model_selection.train_test_split(idxT, test_size=1 - self.subsample)
                 estimator.fit(z[idxT], g[idxT])
             else:
-                estimator.fit(z, g)
+                estimator.fit(data, g)
                 pass
             pass
 
@@ -134,10 +161,41 @@ class GradientBoosting(GeneralBoosting):
 
         self.estimators.append(estimator)
         self.transformers.append(transformer)
+        if self._ensemble is not None:
+            if hasattr(estimator, '_handle'):
+                self._ensemble.add(estimator._handle)
+            else:
+                self._ensemble = None
         pass
 
+    def _native_gradients(self, data, y) -> bool:
+        # the optimizers that only rescale the hessian, on a cached dataset (subsampled through its weights)
+        return (isinstance(data, (_core.Dataset, _core.DatasetF32)) and y.shape[1] == 1
+                and getattr(self.loss, '_native', None) is not None
+                and type(self.optimizer) in (GradientDescentOptimizer, NewtonOptimizer))
+
+    def _subsample_weights(self, n: int) -> np.ndarray:
+        # 1 for the round(subsample * n) rows drawn without replacement, 0 for the others
+        w = np.zeros((n,))
+        w[np.random.choice(n, max(int(round(self.subsample * n)), 1), replace=False)] = 1.0
+        return w
+
+    # pickled for scoring: the trees (binary, see Tree/Ensemble) without the training state
+    _training_state = ('x', 'y', 'predictions', 'total_prediction', '_dataset', 'build_estimator', 'build_transformer')
+
+    def __getstate__(self):
+        state = self.__dict__.copy()
+        for key in self._training_state:
+            state.pop(key, None)
+        return state
+
     def predict(self, x: np.ndarray) -> np.ndarray:
         # TODO: handle transformers
+        if getattr(self, '_ensemble', None) is not None and self._ensemble.size() == len(self.estimators):
+            out = np.zeros((x.shape[0],))
+            self._ensemble.predict_inplace(maybe_numpyToDMatrix(x, self.n_threads), _core.numpyToDColumn(out),
+                                           self.n_threads)
+            return out.reshape(-1, 1)
         out = np.zeros((x.shape[0], 1))
         out += self.baseline
         if self.current_iteration >= 0:
@@ -154,3 +212,79 @@ class GradientBoosting(GeneralBoosting):
         return self.estimators[k].predict(self.transformers[k].transform(x)).reshape(x.shape[0], -1)
 
     pass
+
+
+class NativeGradientBoosting(BaseEstimator):
+    """Gradient boosting with the whole training loop in C++ (GBMTrainer): one call, no per-round round-trips."""
+
+    def __init__(self, n_estimators: int = 100, learning_rate: float = 0.1, max_depth: int = 6,
+                 max_delta_step: float = np.inf, loss: str = 'mse',
+                 min_samples_leaf: int = 1, min_samples_split: int = 2,
+                 min_weight_leaf: float = 0.0, min_weight_split: float = 0.0,
+                 colsample_bytree: float = 1.0, colsample_bylevel: float = 1.0,
+                 reg_lambda: float = 1.0, reg_alpha: float = 0.0,
+                 tree_method: str = 'exact', max_bins: int = 256, n_threads: int = 1):
+        self.n_estimators: int = n_estimators
+        self.learning_rate: float = learning_rate
+        self.max_depth: int = max_depth
+        self.max_delta_step: float = max_delta_step
+        self.loss: str = loss
+        self.min_samples_leaf: int = min_samples_leaf
+        self.min_samples_split: int = min_samples_split
+        self.min_weight_leaf: float = min_weight_leaf
+        self.min_weight_split: float = min_weight_split
+        self.colsample_bytree: float = colsample_bytree
+        self.colsample_bylevel: float = colsample_bylevel
+        self.reg_lambda: float = reg_lambda
+        self.reg_alpha: float = reg_alpha
+        self.tree_method: str = tree_method
+        self.max_bins: int = max_bins
+        self.n_threads: int = n_threads
+        pass
+
+    def fit(self, x: np.ndarray, y: np.ndarray, sample_weight: typing.Union[None, np.ndarray] = None, eval_set=None,
+            eval_metric=None, callback=None, callback_every: int = 1):
+        """callback(iteration, training_loss) is called every callback_every rounds, returning True stops.
+        x may be a PagedDataset (load_paged_dataset) to train out of core."""
+        assert sample_weight is None
+        self._y = np.ascontiguousarray(y, dtype=np.float64).ravel()
+        params = dict(
+            n_estimators=self.n_estimators, learning_rate=self.learning_rate, max_delta_step=self.max_delta_step,
+            max_depth=self.max_depth,
+            min_samples_leaf=self.min_samples_leaf, min_samples_split=self.min_samples_split,
+            min_weight_leaf=self.min_weight_leaf, min_weight_split=self.min_weight_split,
+            colsample_bytree=self.colsample_bytree, colsample_bylevel=self.colsample_bylevel,
+            reg_lambda=self.reg_lambda, reg_alpha=self.reg_alpha, n_threads=self.n_threads)
+        if isinstance(x, _core.PagedDataset):
+            # out of core: histogram trees on the bins of the file, tree_method and max_bins come from it
+            self._trainer = _core.PagedGBMTrainer(x, _core.numpyToDColumn(self._y), self.loss, **params)
+        else:
+            # float32 features are kept as they are, the trainer comes in both precisions
+            x_ = maybe_numpyToDMatrix(x, self.n_threads)
+            trainer_class = _core.GBMTrainerF32 if isinstance(x_, _core.DMatrixF32) else _core.GBMTrainer
+            self._trainer = trainer_class(x_, _core.numpyToDColumn(self._y), self.loss,
+                                          tree_method=self.tree_method, max_bins=self.max_bins, **params)
+        self._ensemble = self._trainer.train(callback, callback_every)
+        self._eval(eval_set, eval_metric)
+        return self
+
+    # the ensemble is pickled on its own, the trainer that produced it is dropped
+    def __getstate__(self):
+        state = self.__dict__.copy()
+        state.pop('_trainer', None)
+        state.pop('_y', None)
+        return state
+
+    def predict_raw(self, x: np.ndarray) -> np.ndarray:
+        out = np.zeros((x.shape[0],))
+        self._ensemble.predict_inplace(maybe_numpyToDMatrix(x, self.n_threads), _core.numpyToDColumn(out),
+                                       self.n_threads)
+        return out.reshape(-1, 1)
+
+    def predict(self, x: np.ndarray) -> np.ndarray:
+        p = self.predict_raw(x)
+        if self.loss.lower() == 'logloss':
+            return sigmoid(p)
+        return p
+
+    pass
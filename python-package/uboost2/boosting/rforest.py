@@ -3,8 +3,10 @@ import pandas as pd
 from sklearn import model_selection
 
 from .base import GeneralBoosting
-from ..transformers import ColumnSamplerTransformer, DummyTransformer
-from ..estimators.tree import DecisionTreeRegressor
+from ..core import _core
+from ..estimators.base import BaseEstimator
+from ..transformers import DummyTransformer
+from ..estimators.tree import DecisionTreeRegressor, maybe_numpyToDataset, maybe_numpyToDMatrix
 
 
 class RandomForestRegressor(GeneralBoosting):
@@ -13,7 +15,9 @@ class RandomForestRegressor(GeneralBoosting):
     def __init__(self, n_estimators: int = 10, max_depth=10, colsample_bytree=0.5, subsample=1.0):
         super(RandomForestRegressor, self).__init__(n_estimators=n_estimators)
         self.transformers = list()
-        self.estiamtor_builder = lambda: DecisionTreeRegressor(max_depth=max_depth)
+        # the columns are drawn by the builder, every tree with its own seed
+        self.estiamtor_builder = lambda: DecisionTreeRegressor(max_depth=max_depth, colsample_bytree=colsample_bytree,
+                                                               seed=np.random.randint(0, 2 ** 31))
         self.colsample_bytree = colsample_bytree
         self.subsample = subsample
         pass
@@ -26,20 +30,27 @@ class RandomForestRegressor(GeneralBoosting):
         self.oof_mse = []
         self.list_idxV = []
         self.y_std = self.y.std()
+        # sorted once for all the trees
+        self._dataset = None
         pass
 
     def _fit_learner(self):
-        transformer = ColumnSamplerTransformer(frac=self.colsample_bytree)
-        z: np.ndarray = transformer.fit_transform(self.x)
+        # rows out of the subsample get weight 0 over the shared dataset, no copy of the matrix
+        transformer = DummyTransformer()
+        z: np.ndarray = self.x
+        if self._dataset is None:
+            self._dataset = maybe_numpyToDataset(z)
 
         idxT = np.arange(z.shape[0])
         idxV = None
         if self.subsample is not None:
             if self.subsample < 1.0:
                 idxT, idxV = model_selection.train_test_split(idxT, test_size=1 - self.subsample)
+        w = np.zeros((z.shape[0],))
+        w[idxT] = 1.0
 
         estimator = self.estiamtor_builder()
-        estimator.fit(z[idxT], self.y[idxT])
+        estimator.fit(self._dataset.with_w(_core.numpyToDColumn(w)), self.y)
 
         if idxV is not None:
             pred = estimator.predict(z[idxV])
@@ -75,3 +86,57 @@ class RandomForestRegressor(GeneralBoosting):
             p += [pi[idx[i]]]
         out = np.stack(p, 0).mean(1)
         return out
+
+
+class NativeRandomForestRegressor(BaseEstimator):
+    """Random forest with the trees built in C++ (ForestTrainer), concurrently, over one shared sorted dataset.
+    Each tree sees its own bootstrap (or subsample) and its own columns; the result does not depend on n_threads."""
+
+    def __init__(self, n_estimators: int = 100, max_depth: int = 10, subsample: float = 1.0, bootstrap: bool = True,
+                 min_samples_leaf: int = 1, min_samples_split: int = 2,
+                 min_weight_leaf: float = 0.0, min_weight_split: float = 0.0,
+                 colsample_bytree: float = 1.0, colsample_bylevel: float = 1.0,
+                 seed: int = 0, n_threads: int = 1):
+        self.n_estimators: int = n_estimators
+        self.max_depth: int = max_depth
+        self.subsample: float = subsample
+        self.bootstrap: bool = bootstrap
+        self.min_samples_leaf: int = min_samples_leaf
+        self.min_samples_split: int = min_samples_split
+        self.min_weight_leaf: float = min_weight_leaf
+        self.min_weight_split: float = min_weight_split
+        self.colsample_bytree: float = colsample_bytree
+        self.colsample_bylevel: float = colsample_bylevel
+        self.seed: int = seed
+        self.n_threads: int = n_threads
+        pass
+
+    def fit(self, x: np.ndarray, y: np.ndarray, sample_weight=None):
+        assert sample_weight is None
+        y_ = np.ascontiguousarray(y, dtype=np.float64).ravel()
+        x_ = maybe_numpyToDMatrix(x, self.n_threads)
+        trainer_class = _core.ForestTrainerF32 if isinstance(x_, _core.DMatrixF32) else _core.ForestTrainer
+        self._trainer = trainer_class(
+            x_, _core.numpyToDColumn(y_),
+            n_estimators=self.n_estimators, subsample=self.subsample, bootstrap=self.bootstrap,
+            max_depth=self.max_depth,
+            min_samples_leaf=self.min_samples_leaf, min_samples_split=self.min_samples_split,
+            min_weight_leaf=self.min_weight_leaf, min_weight_split=self.min_weight_split,
+            colsample_bytree=self.colsample_bytree, colsample_bylevel=self.colsample_bylevel,
+            seed=self.seed, n_threads=self.n_threads)
+        self._ensemble = self._trainer.train()
+        return self
+
+    # the ensemble is pickled on its own, the trainer that produced it is dropped
+    def __getstate__(self):
+        state = self.__dict__.copy()
+        state.pop('_trainer', None)
+        return state
+
+    def predict(self, x: np.ndarray) -> np.ndarray:
+        out = np.zeros((x.shape[0],))
+        self._ensemble.predict_inplace(maybe_numpyToDMatrix(x, self.n_threads), _core.numpyToDColumn(out),
+                                       self.n_threads)
+        return out.reshape(-1, 1)
+
+    pass
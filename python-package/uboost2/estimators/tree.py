@@ -7,18 +7,114 @@ from ..core import _core
 __DMatrix_dict = dict()
 
 
-def maybe_numpyToDMatrix(x):
+# arrays are wrapped without copying when their layout allows it: the trees never write into x/y
+def maybe_numpyToDMatrix(x, n_threads: int = 1):
     if isinstance(x, np.ndarray):
-        return _core.numpyToDMatrix(x.copy())
+        return _core.numpyToDMatrix(x, n_threads)
     return x
 
 
 def maybe_numpyToDColumn(x):
     if isinstance(x, np.ndarray):
-        return _core.numpyToDColumn(x.copy())
+        return _core.numpyToDColumn(x)
     return x
 
 
+def is_sparse(x) -> bool:
+    return hasattr(x, 'tocsc') and hasattr(x, 'nnz')
+
+
+# scipy.sparse input: CSC for training, CSR for prediction
+# tocsc/tocsr return x itself when it already has the format: it is copied before sorting or summing
+# its duplicate entries, so the caller's matrix is never modified
+def canonical_format(x):
+    if not x.has_canonical_format:
+        x = x.copy()
+        x.sum_duplicates()
+    return x
+
+
+def scipyToCSCMatrix(x):
+    x = canonical_format(x.tocsc())
+    return _core.numpyToCSCMatrix(x.indptr, x.indices, x.data, x.shape[0], x.shape[1])
+
+
+def scipyToCSRMatrix(x):
+    x = canonical_format(x.tocsr())
+    return _core.numpyToCSRMatrix(x.indptr, x.indices, x.data, x.shape[0], x.shape[1])
+
+
+# dataset files hold the features with their sorted index (and bins when max_bins > 0): loading maps
+# the file instead of sorting, and the processes loading the same file share its pages
+def save_dataset(x, path: str, max_bins: int = 0, n_threads: int = 1):
+    _core.save_dataset(maybe_numpyToDataset(x, n_threads), path, max_bins)
+
+
+def load_dataset(path: str, n_threads: int = 1):
+    dataset_class = _core.DatasetF32 if _core.dataset_feature_size(path) == 4 else _core.Dataset
+    return dataset_class.load(path, n_threads)
+
+
+# paged dataset files hold only the bins, in row pages read a few at a time: for training sets larger than
+# memory (NativeGradientBoosting takes the loaded file as x); x is an array, a sequence of row chunks, or a
+# function returning a fresh iterable of them (e.g. a generator function reading them from disk): the chunks
+# are read twice, once for the cuts and once for the pages
+def save_paged_dataset(x, path: str, max_bins: int = 256, page_rows: int = 65536, n_threads: int = 1):
+    if isinstance(x, np.ndarray):
+        _core.save_paged_dataset(maybe_numpyToDMatrix(x, n_threads), path, max_bins, page_rows, n_threads)
+        return
+    if callable(x):
+        chunks = x
+    elif iter(x) is x:
+        raise ValueError('An iterator is used up by the first pass: give a sequence of chunks, '
+                         'or a function returning a fresh iterable of them')
+    else:
+        chunks = lambda: x
+    writer = None
+    n_sketched = 0
+    for chunk in chunks():
+        chunk_ = maybe_numpyToDMatrix(np.asarray(chunk), n_threads)
+        if writer is None:
+            writer_class = _core.PagedDatasetWriterF32 if isinstance(chunk_, _core.DMatrixF32) else _core.PagedDatasetWriter
+            writer = writer_class(path, chunk_.ncols(), max_bins, page_rows, n_threads)
+        writer.sketch(chunk_)
+        n_sketched += chunk_.nrows()
+    if n_sketched == 0:
+        raise ValueError('No rows to write')
+    n_appended = 0
+    for chunk in chunks():
+        chunk_ = maybe_numpyToDMatrix(np.asarray(chunk), n_threads)
+        writer.append(chunk_)
+        n_appended += chunk_.nrows()
+    if n_appended != n_sketched:
+        raise ValueError('The chunks gave %d rows to the cuts but %d to the pages' % (n_sketched, n_appended))
+    writer.close()
+
+
+def load_paged_dataset(path: str):
+    return _core.PagedDataset(path)
+
+
+def maybe_numpyToDataset(x, n_threads: int = 1):
+    # a Dataset is reused as it is: its columns are already sorted/quantized
+    if isinstance(x, (_core.Dataset, _core.DatasetF32)):
+        return x
+    if isinstance(x, str):
+        return load_dataset(x, n_threads)
+    x_ = maybe_numpyToDMatrix(x, n_threads)
+    if isinstance(x_, _core.DMatrixF32):
+        return _core.DatasetF32(x_, n_threads)
+    return _core.Dataset(x_, n_threads)
+
+
+# float32 features train without widening: the builders come in both precisions, the F32 ones
+# named with a suffix
+def for_precision(builder_class, data):
+    if isinstance(data, (_core.DatasetF32, _core.DMatrixF32)):
+        return getattr(_core, builder_class.__name__ + 'F32')
+    return builder_class
+
+
 class AbstractTreeRegressor:
     pass
 
@@ -39,13 +135,26 @@ class DecisionTreeRegressor(AbstractTreeRegressor, BaseEstimator):
     x_dmatrix = None
 
     def __init__(self, max_depth=10, min_samples_leaf: int = 1, min_samples_split: int = 2,
-                 colsample_bytree: float = 1.0, colsample_bylevel: float = 1.0):
+                 colsample_bytree: float = 1.0, colsample_bylevel: float = 1.0,
+                 tree_method: str = 'exact', max_bins: int = 256, n_threads: int = 1, seed: int = 0):
         self._handle = _core.Tree(max_depth)
-        self._builder_class = _core.LayerWiseTreeBuilder
         self.min_samples_leaf = min_samples_leaf
         self.min_samples_split = min_samples_split
         self.colsample_bytree = colsample_bytree
         self.colsample_bylevel = colsample_bylevel
+        self.tree_method: str = tree_method
+        self.max_bins: int = max_bins
+        self.n_threads: int = n_threads
+        # drives the column sampling
+        self.seed: int = seed
+        self._builder_kwargs = dict()
+        if tree_method == 'exact':
+            self._builder_class = _core.LayerWiseTreeBuilder
+        elif tree_method == 'hist':
+            self._builder_class = _core.HistLayerWiseTreeBuilder
+            self._builder_kwargs['max_bins'] = max_bins
+        else:
+            raise ValueError("Tree method %s not found" % tree_method)
         pass
 
     def fit(self, x: np.ndarray, y: np.ndarray, sample_weight: typing.Union[None, np.ndarray] = None, eval_set=None,
@@ -53,13 +162,17 @@ class DecisionTreeRegressor(AbstractTreeRegressor, BaseEstimator):
         if y.ndim == 2 and y.shape[-1] == 1:
             y = y.squeeze()
 
-        x_ = maybe_numpyToDMatrix(x)
-        y_ = maybe_numpyToDColumn(y)
-        builder = self._builder_class(x_, y_,
-                                      min_samples_leaf=self.min_samples_leaf,
-                                      min_samples_split=self.min_samples_split,
-                                      colsample_bytree=self.colsample_bytree,
-                                      colsample_bylevel=self.colsample_bylevel)
+        data = maybe_numpyToDataset(x, self.n_threads)
+        data.set_y(maybe_numpyToDColumn(y))
+        builder_class = for_precision(self._builder_class, data)
+        builder = builder_class(data,
+                                min_samples_leaf=self.min_samples_leaf,
+                                min_samples_split=self.min_samples_split,
+                                colsample_bytree=self.colsample_bytree,
+                                colsample_bylevel=self.colsample_bylevel,
+                                seed=self.seed,
+                                n_threads=self.n_threads,
+                                **self._builder_kwargs)
         builder.update(self._handle)
         self._eval(eval_set, eval_metric)
         return self
@@ -79,7 +192,7 @@ class DecisionTreeRegressor(AbstractTreeRegressor, BaseEstimator):
         return outs
 
     def predict(self, x: np.ndarray) -> np.ndarray:
-        x_ = maybe_numpyToDMatrix(x)
+        x_ = maybe_numpyToDMatrix(x, self.n_threads)
         out = np.zeros((x.shape[0],))
         out_ = self._handle.predict_value(x_)
         _core.DColumntoNumpyInplace(out_, out)
@@ -87,7 +200,7 @@ class DecisionTreeRegressor(AbstractTreeRegressor, BaseEstimator):
         return out
 
     def predict_leaf(self, x: np.ndarray) -> np.ndarray:
-        x_ = maybe_numpyToDMatrix(x)
+        x_ = maybe_numpyToDMatrix(x, self.n_threads)
         out = np.array([self._handle.predict_leaf(x_, i) for i in range(x.shape[0])])
         del x_
         return out.astype(int)
@@ -97,8 +210,10 @@ class GHDecisionTreeRegressor(AbstractTreeRegressor):
     def __init__(self, max_depth: int = 10, min_samples_leaf: int = 1, min_samples_split: int = 2,
                  min_weight_leaf: float = 0.0, min_weight_split: float = 0.0,
                  colsample_bytree: float = 1.0, colsample_bylevel: float = 1.0,
-                 reg_lambda: float = 1.0, reg_alpha: float = 0.0):
-        self._builder_class = _core.GHLayerWiseTreeBuilder
+                 reg_lambda: float = 1.0, reg_alpha: float = 0.0,
+                 tree_method: str = 'exact', max_bins: int = 256, n_threads: int = 1,
+                 grow_policy: str = 'depthwise', max_leaves: int = 31,
+                 top_rate: float = 1.0, other_rate: float = 0.0):
         self._handle = _core.Tree(max_depth)
         self.min_samples_leaf = min_samples_leaf
         self.min_samples_split = min_samples_split
@@ -108,34 +223,107 @@ class GHDecisionTreeRegressor(AbstractTreeRegressor):
         self.colsample_bylevel = colsample_bylevel
         self.reg_lambda = reg_lambda
         self.reg_alpha = reg_alpha
+        self.tree_method: str = tree_method
+        self.max_bins: int = max_bins
+        self.n_threads: int = n_threads
+        self.grow_policy: str = grow_policy
+        self.max_leaves: int = max_leaves
+        # gradient-based one-side sampling, off while top_rate + other_rate >= 1
+        self.top_rate: float = top_rate
+        self.other_rate: float = other_rate
+        self._builder_kwargs = dict()
+        if grow_policy == 'lossguide':
+            if tree_method != 'exact':
+                raise ValueError("Grow policy lossguide is only available with tree method exact")
+            self._builder_class = _core.GHLeafWiseTreeBuilder
+            self._builder_kwargs['max_leaves'] = max_leaves
+        elif grow_policy != 'depthwise':
+            raise ValueError("Grow policy %s not found" % grow_policy)
+        elif tree_method == 'exact':
+            self._builder_class = _core.GHLayerWiseTreeBuilder
+        elif tree_method == 'hist':
+            self._builder_class = _core.GHHistLayerWiseTreeBuilder
+            self._builder_kwargs['max_bins'] = max_bins
+        else:
+            raise ValueError("Tree method %s not found" % tree_method)
+        if top_rate < 0.0 or other_rate < 0.0:
+            raise ValueError("top_rate and other_rate must be non-negative")
+        if top_rate + other_rate < 1.0:
+            if top_rate + other_rate <= 0.0:
+                raise ValueError("GOSS needs top_rate + other_rate > 0")
+            if grow_policy != 'depthwise':
+                raise ValueError("GOSS is only available with grow policy depthwise")
+            self._builder_kwargs['top_rate'] = top_rate
+            self._builder_kwargs['other_rate'] = other_rate
         pass
 
-    def fit_gh(self, x: np.ndarray, g: np.ndarray, h: np.ndarray, sample_weight: typing.Union[None, np.ndarray] = None,
+    def fit_gh(self, x: np.ndarray, g: typing.Union[None, np.ndarray], h: typing.Union[None, np.ndarray],
+               sample_weight: typing.Union[None, np.ndarray] = None,
                eval_set=None,
                eval_metric=None):
-        if g.ndim == 2 and g.shape[-1] == 1:
-            g = g.squeeze()
-        if h.ndim == 2 and h.shape[-1] == 1:
-            h = h.squeeze()
+        if is_sparse(x):
+            return self._fit_gh_sparse(x, g, h, sample_weight)
+        # g/h None: x is a Dataset whose gradients were already written (Dataset.update_gradients)
+        data = maybe_numpyToDataset(x, self.n_threads)
+        if g is not None:
+            if g.ndim == 2 and g.shape[-1] == 1:
+                g = g.squeeze()
+            data.set_g(maybe_numpyToDColumn(g))
+        if h is not None:
+            if h.ndim == 2 and h.shape[-1] == 1:
+                h = h.squeeze()
+            data.set_h(maybe_numpyToDColumn(h))
+        if sample_weight is not None:
+            sample_weight = np.ascontiguousarray(sample_weight, dtype=np.float64).ravel()
+            data = data.with_w(_core.numpyToDColumn(sample_weight))
+        # a fresh seed per tree: the column subsets and the GOSS sample change every boosting round
+        self._builder_kwargs['seed'] = np.random.randint(0, 2 ** 31)
+        builder_class = for_precision(self._builder_class, data)
+        builder = builder_class(data,
+                                min_samples_leaf=self.min_samples_leaf,
+                                min_samples_split=self.min_samples_split,
+                                min_weight_leaf=self.min_weight_leaf,
+                                min_weight_split=self.min_weight_split,
+                                colsample_bytree=self.colsample_bytree,
+                                colsample_bylevel=self.colsample_bylevel,
+                                reg_lambda=self.reg_lambda,
+                                reg_alpha=self.reg_alpha,
+                                n_threads=self.n_threads,
+                                **self._builder_kwargs)
+        builder.update(self._handle)
+        # per-phase seconds and per-depth counters of the build, filled when the core is compiled with
+        # UBOOST2_PROFILE (depthwise builders only)
+        self.stats_ = builder.get_stats() if hasattr(builder, 'get_stats') else None
+        del data
+        return self
 
-        x_ = maybe_numpyToDMatrix(x)
-        g_ = maybe_numpyToDColumn(g)
-        h_ = maybe_numpyToDColumn(h)
-        builder = self._builder_class(x_, g_, h_,
-                                      min_samples_leaf=self.min_samples_leaf,
-                                      min_samples_split=self.min_samples_split,
-                                      min_weight_leaf=self.min_weight_leaf,
-                                      min_weight_split=self.min_weight_split,
-                                      colsample_bytree=self.colsample_bytree,
-                                      colsample_bylevel=self.colsample_bylevel,
-                                      reg_lambda=self.reg_lambda,
-                                      reg_alpha=self.reg_alpha)
+    def _fit_gh_sparse(self, x, g: np.ndarray, h: np.ndarray, sample_weight: typing.Union[None, np.ndarray] = None):
+        # absent entries are a default bucket sent left or right at every split
+        if self.tree_method != 'exact' or self.grow_policy != 'depthwise' or 'top_rate' in self._builder_kwargs:
+            raise ValueError("Sparse input is only available with tree method exact, grow policy depthwise and no GOSS")
+        g = np.ascontiguousarray(g, dtype=np.float64).ravel()
+        h = np.ascontiguousarray(h, dtype=np.float64).ravel()
+        w = np.ones_like(g) if sample_weight is None else np.ascontiguousarray(sample_weight, dtype=np.float64).ravel()
+        if w.shape != g.shape:
+            raise ValueError("sample_weight has %d rows, expected %d" % (w.shape[0], g.shape[0]))
+        builder = _core.GHSparseLayerWiseTreeBuilder(scipyToCSCMatrix(x),
+                                                     _core.numpyToDColumn(g), _core.numpyToDColumn(h),
+                                                     _core.numpyToDColumn(w),
+                                                     min_samples_leaf=self.min_samples_leaf,
+                                                     min_samples_split=self.min_samples_split,
+                                                     min_weight_leaf=self.min_weight_leaf,
+                                                     min_weight_split=self.min_weight_split,
+                                                     colsample_bytree=self.colsample_bytree,
+                                                     colsample_bylevel=self.colsample_bylevel,
+                                                     reg_lambda=self.reg_lambda,
+                                                     reg_alpha=self.reg_alpha,
+                                                     seed=np.random.randint(0, 2 ** 31),
+                                                     n_threads=self.n_threads)
         builder.update(self._handle)
-        del x_, g_, h_
         return self
 
     def predict(self, x: np.ndarray) -> np.ndarray:
-        x_ = maybe_numpyToDMatrix(x)
+        x_ = scipyToCSRMatrix(x) if is_sparse(x) else maybe_numpyToDMatrix(x, self.n_threads)
         out_ = self._handle.predict_value(x_)
         out = np.zeros((x.shape[0],))
         _core.DColumntoNumpyInplace(out_, out)
@@ -144,7 +332,7 @@ class GHDecisionTreeRegressor(AbstractTreeRegressor):
 
     @staticmethod
     def predict_many(trees: typing.List, x: np.ndarray) -> typing.List[np.ndarray]:
-        x_ = maybe_numpyToDMatrix(x)
+        x_ = scipyToCSRMatrix(x) if is_sparse(x) else maybe_numpyToDMatrix(x)
         outs = []
         for tree in trees:
             out = np.zeros((x.shape[0],))
@@ -4,6 +4,17 @@ import numpy as np
 
 class Loss:
     name: str = 'Loss'
+    # name of the fused C++ kernel computing g and h in one pass, if any
+    _native_name: typing.Optional[str] = None
+    _native_kernel = None
+
+    @property
+    def _native(self):
+        # created on first use: the module imports without the extension
+        if self._native_kernel is None and self._native_name is not None:
+            from .core import _core
+            self._native_kernel = getattr(_core, self._native_name)()
+        return self._native_kernel
 
     def __call__(self, y: np.ndarray, p: np.ndarray) -> float:
         return self.value(y, p)
@@ -18,11 +29,20 @@ class Loss:
         raise NotImplementedError
 
     def grad_and_hess(self, y: np.ndarray, p: np.ndarray) -> typing.Tuple[np.ndarray, np.ndarray]:
+        if self._native_name is not None and np.shape(y) == np.shape(p):
+            from .core import _core
+            g = np.empty(np.shape(p))
+            h = np.empty(np.shape(p))
+            self._native.grad_and_hess(_core.numpyToDColumn(np.ravel(y).astype(np.float64, copy=False)),
+                                       _core.numpyToDColumn(np.ravel(p).astype(np.float64, copy=False)),
+                                       _core.numpyToDColumn(g.reshape(-1)), _core.numpyToDColumn(h.reshape(-1)))
+            return g, h
         return self.grad(y, p), self.hess(y, p)
 
 
 class MSELoss(Loss):
     name: str = 'MSE'
+    _native_name = 'MSELoss'
 
     def value(self, y: np.ndarray, p: np.ndarray) -> float:
         return float(np.mean((y - p) ** 2.0))
@@ -42,6 +62,7 @@ def sigmoid(x: np.ndarray) -> np.ndarray:
 
 class LogLoss(Loss):
     name: str = 'LogLoss'
+    _native_name = 'LogLoss'
 
     def value(self, y: np.ndarray, p: np.ndarray) -> float:
         pr = sigmoid(p)
@@ -0,0 +1,340 @@
+// kernel micro-benchmarks: every case runs on data drawn from a fixed seed and is reported as one
+// JSON object (min/median/mean seconds over the repeats), so two builds can be diffed case by case
+//
+//   bench [--rows 10000,100000] [--cols 8,32] [--depths 6,10] [--threads 1,4] [--repeats 5]
+//         [--seed 42] [--kernels split_scan,predict] [--quick]
+//
+// kernels: numpy_to_dmatrix, sort_columns, split_scan, position_update, tree_build, predict
+// the JSON goes to stdout, the progress to stderr
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+#include <uboost2/data.h>
+#include <uboost2/parallel.h>
+#include <uboost2/sparse.h>
+#include <uboost2/tree/tree.h>
+#include <uboost2/tree/ensemble.h>
+#include <uboost2/tree/splitter.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/tree/sorted_index.h>
+#include <uboost2/tree/builder/builder_layerwise_gh.h>
+#include <uboost2/tree/builder/builder_layerwise_hist_gh.h>
+#include <uboost2/tree/builder/builder_layerwise_sparse_gh.h>
+
+namespace bench {
+
+	struct Config {
+		std::vector<size_t> rows = { 10000, 100000, 1000000 };
+		std::vector<size_t> cols = { 8, 32 };
+		std::vector<size_t> depths = { 6, 10 };
+		std::vector<int> threads;
+		std::vector<std::string> kernels;
+		size_t repeats = 5;
+		unsigned seed = 42;
+	};
+
+	struct Case {
+		std::string kernel;
+		size_t rows, cols, depth;
+		int threads;
+		// what the throughput is counted in (rows, cells, ...) and how many per run
+		std::string unit;
+		double items;
+		std::vector<double> seconds;
+	};
+
+	// keeps the results alive so the optimizer cannot drop the work
+	volatile double sink = 0.0;
+
+	template <typename T>
+	std::vector<T> parse_list(const char* arg) {
+		std::vector<T> out;
+		std::stringstream ss(arg);
+		std::string item;
+		while (std::getline(ss, item, ',')) {
+			std::stringstream value(item);
+			T t;
+			value >> t;
+			out.push_back(t);
+		}
+		return out;
+	}
+
+	// one warm-up run, then the timed ones; setup (untimed) runs before each of them
+	void measure(Case& c, size_t repeats, const std::function<void()>& setup, const std::function<void()>& run) {
+		setup();
+		run();
+		for (size_t r = 0; r < repeats; r++) {
+			setup();
+			const auto t0 = std::chrono::steady_clock::now();
+			run();
+			const auto t1 = std::chrono::steady_clock::now();
+			c.seconds.push_back(std::chrono::duration<double>(t1 - t0).count());
+		}
+	}
+
+	// target of the trees: a few interactions and a step, plus noise
+	DColumn<> target(const DMatrix<>& x, unsigned seed) {
+		std::mt19937 gen(seed + 1);
+		std::normal_distribution<> noise(0.0, 0.5);
+		DColumn<> y(x.nrows());
+		for (size_t i = 0; i < x.nrows(); i++) {
+			const double a = x(i, 0), b = x(i, 1 % x.ncols()), c = x(i, 2 % x.ncols());
+			y(i) = std::sin(6.0 * a) + a * b + (c > 0.5 ? 1.0 : 0.0) + noise(gen);
+		}
+		return y;
+	}
+
+	// the kernels
+
+	// numpy conversion: a C-ordered (row-major) array becomes a column-major DMatrix
+	void numpy_to_dmatrix(std::vector<Case>& out, const Config& cfg, const DMatrix<>& x, int n_threads) {
+		const size_t nrows = x.nrows(), ncols = x.ncols();
+		std::vector<double> row_major(nrows * ncols);
+		for (size_t i = 0; i < nrows; i++) for (size_t j = 0; j < ncols; j++) row_major[i * ncols + j] = x(i, j);
+		Case c{ "numpy_to_dmatrix", nrows, ncols, 0, n_threads, "cells", (double)(nrows * ncols) };
+		measure(c, cfg.repeats, [] {}, [&] {
+			const DMatrix<> m = matrix::from_strided(row_major.data(), nrows, ncols, (ptrdiff_t)ncols, 1, n_threads);
+			sink = sink + m(nrows - 1, ncols - 1);
+		});
+		out.push_back(c);
+	}
+
+	// sorting the columns: the dense sorted index, the bin matrix, and the sparse builder (10% of the entries stored)
+	void sort_columns(std::vector<Case>& out, const Config& cfg, const DMatrix<>& x, int n_threads) {
+		const size_t nrows = x.nrows(), ncols = x.ncols();
+		Case dense{ "sorted_index", nrows, ncols, 0, n_threads, "cells", (double)(nrows * ncols) };
+		measure(dense, cfg.repeats, [] {}, [&] {
+			const SortedIndex index(x, n_threads);
+			sink = sink + index(0, 0);
+		});
+		out.push_back(dense);
+
+		// the quantized alternative: bin cuts from the quantile sketch, then the bin codes
+		Case bins{ "bin_matrix", nrows, ncols, 0, n_threads, "cells", (double)(nrows * ncols) };
+		measure(bins, cfg.repeats, [] {}, [&] {
+			const BinMatrix matrix(x, MAX_BINS, n_threads);
+			sink = sink + matrix(0, 0);
+		});
+		out.push_back(bins);
+
+		std::vector<size_t> indptr(1, 0);
+		std::vector<uint32_t> indices;
+		std::vector<double> values;
+		for (size_t j = 0; j < ncols; j++) {
+			for (size_t i = 0; i < nrows; i++) {
+				if (x(i, (j + 1) % ncols) < 0.1) {
+					indices.push_back((uint32_t)i);
+					values.push_back(x(i, j));
+				}
+			}
+			indptr.push_back(indices.size());
+		}
+		const CSCMatrix<> csc(nrows, ncols, indptr, indices, values);
+		const DColumn<> g(nrows, 1.0), h(nrows, 1.0);
+		Case sparse{ "sparse_sort_columns", nrows, ncols, 0, n_threads, "entries", (double)csc.nnz() };
+		measure(sparse, cfg.repeats, [] {}, [&] {
+			GHSparseLayerWiseTreeBuilder builder(csc, g, h, 1, 2, 0.0, 0.0, 1.0, 1.0, 1.0, 0.0, 0, n_threads);
+			sink = sink + 1.0;
+		});
+		out.push_back(sparse);
+	}
+
+	// GHSplitter::build_split over every row of every column in sorted order, columns split among the threads
+	void split_scan(std::vector<Case>& out, const Config& cfg, const DMatrix<>& x, const SortedIndex& index,
+		const DColumn<>& g, int n_threads) {
+		const size_t nrows = x.nrows(), ncols = x.ncols();
+		const DColumn<> h(nrows, 1.0), w(nrows, 1.0);
+		GHSplitter splitter(1, 0.0);
+		for (size_t i = 0; i < nrows; i++) splitter.add(g(i), h(i), w(i));
+		Case c{ "split_scan", nrows, ncols, 0, n_threads, "cells", (double)(nrows * ncols) };
+		measure(c, cfg.repeats, [] {}, [&] {
+			std::vector<double> best(n_threads, -INFINITY);
+			#pragma omp parallel num_threads(n_threads)
+			{
+				GHSplitter local(splitter);
+				double& local_best = best[parallel::thread_id()];
+				#pragma omp for schedule(static)
+				for (int col = 0; col < (int)ncols; col++) {
+					const uint32_t* ocol = index.column_data(col);
+					const double* xcol = x.column_data(col);
+					local.start_splitting(col);
+					for (size_t r = 0; r < nrows; r++) {
+						const uint32_t i = ocol[r];
+						const Split split = local.build_split(i, xcol[i], g(i), h(i), w(i));
+						if (split.succesful) local_best = std::max(local_best, split.criterion_gain);
+					}
+				}
+			}
+			sink = sink + *std::max_element(best.begin(), best.end());
+		});
+		out.push_back(c);
+	}
+
+	// one level of row moves: every row of the 2^depth nodes goes to a child by its node's split
+	void position_update(std::vector<Case>& out, const Config& cfg, const DMatrix<>& x, size_t depth, int n_threads) {
+		const size_t nrows = x.nrows(), ncols = x.ncols();
+		const size_t first = trees::max_idx_at_depth(depth) + 1 - ((size_t)1 << depth);
+		const size_t n_nodes = (size_t)1 << depth;
+		std::mt19937 gen(depth);
+		std::uniform_int_distribution<size_t> column(0, ncols - 1);
+		std::uniform_real_distribution<> threshold(0.0, 1.0);
+		std::vector<size_t> split_column(first + n_nodes);
+		std::vector<double> split_threshold(first + n_nodes);
+		for (size_t k = first; k < first + n_nodes; k++) {
+			split_column[k] = column(gen);
+			split_threshold[k] = threshold(gen);
+		}
+		std::vector<int> start(nrows), position(nrows);
+		for (size_t i = 0; i < nrows; i++) start[i] = (int)(first + i % n_nodes);
+		Case c{ "position_update", nrows, ncols, depth, n_threads, "rows", (double)nrows };
+		measure(c, cfg.repeats, [&] { position = start; }, [&] {
+			#pragma omp parallel for num_threads(n_threads) schedule(static)
+			for (int i = 0; i < (int)nrows; i++) {
+				const int nid = position[i];
+				if (nid < 0) continue;
+				const double v = x.column_data(split_column[nid])[i];
+				if (is_missing(v) || v >= split_threshold[nid]) position[i] = (int)trees::right_child(nid);
+				else position[i] = (int)trees::left_child(nid);
+			}
+			sink = sink + position[nrows - 1];
+		});
+		out.push_back(c);
+	}
+
+	// whole trees on a prepared dataset (sorted/binned once, outside the timing)
+	void tree_build(std::vector<Case>& out, const Config& cfg, Dataset<>& data, size_t depth, int n_threads) {
+		const size_t nrows = data.nrows(), ncols = data.ncols();
+		Case exact{ "tree_build_exact", nrows, ncols, depth, n_threads, "cells", (double)(nrows * ncols) };
+		measure(exact, cfg.repeats, [] {}, [&] {
+			Tree tree(depth);
+			GHLayerWiseTreeBuilder<>(data, 1, 2, 0.0, 0.0, 1.0, 1.0, 1.0, 0.0, 1.0, 0.0, 0, n_threads).update(tree);
+			sink = sink + tree.get_n_leaves();
+		});
+		out.push_back(exact);
+		Case hist{ "tree_build_hist", nrows, ncols, depth, n_threads, "cells", (double)(nrows * ncols) };
+		measure(hist, cfg.repeats, [] {}, [&] {
+			Tree tree(depth);
+			GHHistLayerWiseTreeBuilder<>(data, 1, 2, 0.0, 0.0, 1.0, 1.0, 1.0, 0.0, MAX_BINS, 1.0, 0.0, 0, n_threads).update(tree);
+			sink = sink + tree.get_n_leaves();
+		});
+		out.push_back(hist);
+	}
+
+	// Tree::predict_value (one thread, row by row), and a compiled ensemble of 10 such trees
+	void predict(std::vector<Case>& out, const Config& cfg, Dataset<>& data, size_t depth, int n_threads) {
+		const size_t nrows = data.nrows(), ncols = data.ncols();
+		Tree tree(depth);
+		GHLayerWiseTreeBuilder<>(data, 1, 2, 0.0, 0.0, 1.0, 1.0, 1.0, 0.0, 1.0, 0.0, 0, n_threads).update(tree);
+		if (n_threads == 1) {
+			Case c{ "tree_predict", nrows, ncols, depth, 1, "rows", (double)nrows };
+			measure(c, cfg.repeats, [] {}, [&] {
+				const DColumn<> p = tree.predict_value(data.get_x());
+				sink = sink + p(0);
+			});
+			out.push_back(c);
+		}
+		Ensemble ensemble;
+		for (size_t t = 0; t < 10; t++) ensemble.add(tree);
+		Case c{ "ensemble_predict", nrows, ncols, depth, n_threads, "rows", (double)nrows };
+		measure(c, cfg.repeats, [] {}, [&] {
+			const DColumn<> p = ensemble.predict(data.get_x(), n_threads);
+			sink = sink + p(0);
+		});
+		out.push_back(c);
+	}
+
+	// output
+
+	std::string to_json(const Config& cfg, const std::vector<Case>& cases) {
+		std::ostringstream out;
+		out.precision(9);
+		out << "{\n  \"benchmark\": \"uboost2-kernels\",\n  \"schema\": 1,\n";
+#ifdef __VERSION__
+		out << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+#endif
+		out << "  \"max_threads\": " << parallel::max_threads() << ",\n";
+		out << "  \"seed\": " << cfg.seed << ",\n  \"repeats\": " << cfg.repeats << ",\n  \"results\": [";
+		for (size_t k = 0; k < cases.size(); k++) {
+			const Case& c = cases[k];
+			std::vector<double> s = c.seconds;
+			std::sort(s.begin(), s.end());
+			const double median = s.size() % 2 ? s[s.size() / 2] : 0.5 * (s[s.size() / 2 - 1] + s[s.size() / 2]);
+			const double mean = std::accumulate(s.begin(), s.end(), 0.0) / s.size();
+			out << (k ? ",\n" : "\n") << "    {\"kernel\": \"" << c.kernel << "\", \"rows\": " << c.rows << ", \"cols\": " << c.cols
+				<< ", \"depth\": ";
+			if (c.depth > 0) out << c.depth;
+			else out << "null";
+			out << ", \"threads\": " << c.threads << ", \"min_s\": " << s.front() << ", \"median_s\": " << median
+				<< ", \"mean_s\": " << mean << ", \"unit\": \"" << c.unit << "\", \"" << c.unit << "_per_s\": " << c.items / s.front() << "}";
+		}
+		out << "\n  ]\n}\n";
+		return out.str();
+	}
+}
+
+int main(int argc, char** argv) {
+	using namespace bench;
+	Config cfg;
+	for (int a = 1; a < argc; a++) {
+		const std::string arg = argv[a];
+		const char* value = a + 1 < argc ? argv[a + 1] : "";
+		if (arg == "--rows") cfg.rows = parse_list<size_t>(value), a++;
+		else if (arg == "--cols") cfg.cols = parse_list<size_t>(value), a++;
+		else if (arg == "--depths") cfg.depths = parse_list<size_t>(value), a++;
+		else if (arg == "--threads") cfg.threads = parse_list<int>(value), a++;
+		else if (arg == "--kernels") cfg.kernels = parse_list<std::string>(value), a++;
+		else if (arg == "--repeats") cfg.repeats = std::max<size_t>(1, std::stoul(value)), a++;
+		else if (arg == "--seed") cfg.seed = (unsigned)std::stoul(value), a++;
+		else if (arg == "--quick") {
+			cfg.rows = { 10000, 100000 };
+			cfg.cols = { 8 };
+			cfg.depths = { 6 };
+			cfg.repeats = 3;
+		}
+		else {
+			std::fprintf(stderr, "unknown argument %s\n", arg.c_str());
+			return 1;
+		}
+	}
+	if (cfg.threads.empty()) {
+		cfg.threads = { 1 };
+		if (parallel::max_threads() > 1) cfg.threads.push_back(parallel::max_threads());
+	}
+	auto wanted = [&](const char* kernel) {
+		return cfg.kernels.empty() || std::find(cfg.kernels.begin(), cfg.kernels.end(), kernel) != cfg.kernels.end();
+	};
+
+	std::vector<Case> cases;
+	for (size_t nrows : cfg.rows) for (size_t ncols : cfg.cols) {
+		const DMatrix<> x = randoms::uniform(nrows, ncols, cfg.seed);
+		const DColumn<> y = target(x, cfg.seed);
+		Dataset<> data(x);
+		data.set_g(y);
+		data.get_index();
+		data.get_bins(MAX_BINS);
+		for (int n_threads : cfg.threads) {
+			std::fprintf(stderr, "rows %zu cols %zu threads %d\n", nrows, ncols, n_threads);
+			if (wanted("numpy_to_dmatrix")) numpy_to_dmatrix(cases, cfg, x, n_threads);
+			if (wanted("sort_columns")) sort_columns(cases, cfg, x, n_threads);
+			if (wanted("split_scan")) split_scan(cases, cfg, x, data.get_index(), y, n_threads);
+			for (size_t depth : cfg.depths) {
+				if (wanted("position_update")) position_update(cases, cfg, x, depth, n_threads);
+				if (wanted("tree_build")) tree_build(cases, cfg, data, depth, n_threads);
+				if (wanted("predict")) predict(cases, cfg, data, depth, n_threads);
+			}
+		}
+	}
+	std::fputs(to_json(cfg, cases).c_str(), stdout);
+	return 0;
+}
@@ -1,33 +1,309 @@
 #pragma once
 
 #include <pybind11/pybind11.h>
+#include <pybind11/functional.h>
 
 #include <uboost2/numpy_utils.h>
+#include <uboost2/losses.h>
 
 #include <uboost2/tree/tree.h>
+#include <uboost2/tree/dataset.h>
+#include <uboost2/tree/dataset_file.h>
+#include <uboost2/tree/compiled_tree.h>
+#include <uboost2/tree/ensemble.h>
+#include <uboost2/tree/model_file.h>
 #include <uboost2/tree/builder/builder_layerwise.h>
 #include <uboost2/tree/builder/builder_layerwise_gh.h>
 #include <uboost2/tree/builder/builder_base.h>
+#include <uboost2/tree/builder/builder_layerwise_hist.h>
+#include <uboost2/tree/builder/builder_layerwise_hist_gh.h>
+#include <uboost2/tree/builder/builder_leafwise_gh.h>
+#include <uboost2/tree/builder/builder_layerwise_sparse_gh.h>
+#include <uboost2/boosting/gbm_trainer.h>
+#include <uboost2/boosting/forest_trainer.h>
+#include <uboost2/boosting/paged_gbm_trainer.h>
 
 
 namespace py = pybind11;
 
+// stats of a builder's last update(): empty unless compiled with -DUBOOST2_PROFILE
+inline py::dict stats_to_dict(const profiling::BuilderStats& stats) {
+	auto to_list = [](const std::vector<size_t>& v) {
+		py::list out;
+		for (size_t n : v) out.append(n);
+		return out;
+	};
+	py::dict seconds;
+	for (const auto& [phase, s] : stats.seconds) seconds[py::str(phase)] = s;
+	py::dict out;
+	out["enabled"] = profiling::enabled;
+	out["seconds"] = seconds;
+	out["rows_scanned"] = to_list(stats.rows_scanned);
+	out["candidate_splits"] = to_list(stats.candidate_splits);
+	out["nodes_expanded"] = to_list(stats.nodes_expanded);
+	return out;
+}
+
+inline py::list cuts_to_list(const std::vector<std::vector<double>>& cuts) {
+	py::list out;
+	for (const auto& col : cuts) {
+		py::list c;
+		for (double v : col) c.append(v);
+		out.append(c);
+	}
+	return out;
+}
+
+// the classes templated on the feature precision are exported once per precision:
+// as they were for double, with an F32 suffix for float
+template <typename X>
+void export_precision(py::module_& m, const std::string& suffix) {
+	py::class_<DMatrix<X>>(m, (std::string("DMatrix") + suffix).c_str())
+		.def("nrows", &DMatrix<X>::nrows)
+		.def("ncols", &DMatrix<X>::ncols)
+		;
+	// a float32 array matches the float overload exactly and is not widened
+	m.def("numpyToDMatrix", &numpyToDMatrix<X>, "...", py::arg("x"), py::arg("n_threads") = 1);
+
+	py::class_<Dataset<X>>(m, (std::string("Dataset") + suffix).c_str())
+		.def(py::init<const DMatrix<X>&, int>(), py::arg("x"), py::arg("n_threads") = 1)
+		.def("nrows", &Dataset<X>::nrows)
+		.def("ncols", &Dataset<X>::ncols)
+		.def("set_y", &Dataset<X>::set_y)
+		.def("set_g", &Dataset<X>::set_g)
+		.def("set_h", &Dataset<X>::set_h)
+		.def("set_w", &Dataset<X>::set_w)
+		.def("with_w", &Dataset<X>::with_w, py::arg("w"))
+		.def("update_gradients", &Dataset<X>::update_gradients, py::arg("loss"), py::arg("p"), py::arg("scale") = 1.0, py::arg("newton") = true)
+		.def_static("load", &datasets::load<X>, py::arg("path"), py::arg("n_threads") = 1)
+		;
+	m.def("save_dataset", &datasets::save<X>, "...", py::arg("data"), py::arg("path"), py::arg("max_bins") = 0);
+	// paged (out-of-core) files, written from chunks of rows: sketch() them all, then append() them all
+	py::class_<paging::Writer<X>>(m, (std::string("PagedDatasetWriter") + suffix).c_str())
+		.def(py::init<const std::string&, size_t, size_t, size_t, int>(),
+			py::arg("path"), py::arg("ncols"), py::arg("max_bins") = MAX_BINS, py::arg("page_rows") = paging::PAGE_ROWS,
+			py::arg("n_threads") = 1)
+		.def("sketch", py::overload_cast<const DMatrix<X>&>(&paging::Writer<X>::sketch), py::arg("x"))
+		.def("sketch", py::overload_cast<const DMatrix<X>&, const DColumn<>&>(&paging::Writer<X>::sketch), py::arg("x"), py::arg("w"))
+		.def("append", &paging::Writer<X>::append, py::arg("x"))
+		.def("close", &paging::Writer<X>::close)
+		;
+	m.def("save_paged_dataset", &paging::save<X>, "...", py::arg("x"), py::arg("path"), py::arg("max_bins") = MAX_BINS,
+		py::arg("page_rows") = paging::PAGE_ROWS, py::arg("n_threads") = 1);
+	// bin cuts of every column from the (weighted) quantile sketch, one list per column
+	m.def("quantile_cuts", [](const DMatrix<X>& x, size_t max_bins, int n_threads) {
+		return cuts_to_list(sketches::cuts(x, max_bins, n_threads));
+	}, "...", py::arg("x"), py::arg("max_bins") = MAX_BINS, py::arg("n_threads") = 1);
+	m.def("quantile_cuts", [](const DMatrix<X>& x, const DColumn<>& w, size_t max_bins, int n_threads) {
+		return cuts_to_list(sketches::cuts(x, w, max_bins, n_threads));
+	}, "...", py::arg("x"), py::arg("w"), py::arg("max_bins") = MAX_BINS, py::arg("n_threads") = 1);
+
+	py::class_<LayerWiseTreeBuilder<X>>(m, (std::string("LayerWiseTreeBuilder") + suffix).c_str())
+		.def(py::init<const DMatrix<X>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, unsigned, int>(),
+			py::arg("x"), py::arg("y"),
+			py::arg("min_samples_leaf") = 1,
+			py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0,
+			py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, 
+			py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_alpha") = 0.0,
+			py::arg("seed") = 0,
+			py::arg("n_threads") = 1
+			)
+		.def(py::init<const Dataset<X>&, size_t, size_t, double, double, double, double, double, unsigned, int>(),
+			py::arg("data"),
+			py::arg("min_samples_leaf") = 1,
+			py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0,
+			py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0,
+			py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_alpha") = 0.0,
+			py::arg("seed") = 0,
+			py::arg("n_threads") = 1
+			)
+		.def("update", &LayerWiseTreeBuilder<X>::update)
+		;
+
+	py::class_<GHLayerWiseTreeBuilder<X>>(m, (std::string("GHLayerWiseTreeBuilder") + suffix).c_str())
+		.def(py::init<const DMatrix<X>&, const DColumn<>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, double, double, double, unsigned, int>(),
+			py::arg("x"), py::arg("g"), py::arg("h"), 
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2, 
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda")=1.0, py::arg("reg_alpha")=0.0,
+			py::arg("top_rate") = 1.0, py::arg("other_rate") = 0.0, py::arg("seed") = 0,
+			py::arg("n_threads") = 1)
+		.def(py::init<const Dataset<X>&, size_t, size_t, double, double, double, double, double, double, double, double, unsigned, int>(),
+			py::arg("data"),
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0,
+			py::arg("top_rate") = 1.0, py::arg("other_rate") = 0.0, py::arg("seed") = 0,
+			py::arg("n_threads") = 1)
+		.def("update", &GHLayerWiseTreeBuilder<X>::update)
+		.def("get_stats", [](const GHLayerWiseTreeBuilder<X>& builder) { return stats_to_dict(builder.get_stats()); })
+		;
+
+	py::class_<GHLeafWiseTreeBuilder<X>>(m, (std::string("GHLeafWiseTreeBuilder") + suffix).c_str())
+		.def(py::init<const DMatrix<X>&, const DColumn<>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, double, size_t, unsigned, int>(),
+			py::arg("x"), py::arg("g"), py::arg("h"),
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0,
+			py::arg("max_leaves") = 31, py::arg("seed") = 0,
+			py::arg("n_threads") = 1)
+		.def(py::init<const Dataset<X>&, size_t, size_t, double, double, double, double, double, double, size_t, unsigned, int>(),
+			py::arg("data"),
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0,
+			py::arg("max_leaves") = 31, py::arg("seed") = 0,
+			py::arg("n_threads") = 1)
+		.def("update", &GHLeafWiseTreeBuilder<X>::update)
+		;
+
+	// histogram builders
+	py::class_<HistLayerWiseTreeBuilder<X>>(m, (std::string("HistLayerWiseTreeBuilder") + suffix).c_str())
+		.def(py::init<const DMatrix<X>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, size_t, unsigned, int>(),
+			py::arg("x"), py::arg("y"),
+			py::arg("min_samples_leaf") = 1,
+			py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0,
+			py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0,
+			py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_alpha") = 0.0,
+			py::arg("max_bins") = MAX_BINS,
+			py::arg("seed") = 0,
+			py::arg("n_threads") = 1
+			)
+		.def(py::init<const Dataset<X>&, size_t, size_t, double, double, double, double, double, size_t, unsigned, int>(),
+			py::arg("data"),
+			py::arg("min_samples_leaf") = 1,
+			py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0,
+			py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0,
+			py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_alpha") = 0.0,
+			py::arg("max_bins") = MAX_BINS,
+			py::arg("seed") = 0,
+			py::arg("n_threads") = 1
+			)
+		.def("update", &HistLayerWiseTreeBuilder<X>::update)
+		;
+
+	py::class_<GHHistLayerWiseTreeBuilder<X>>(m, (std::string("GHHistLayerWiseTreeBuilder") + suffix).c_str())
+		.def(py::init<const DMatrix<X>&, const DColumn<>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, double, size_t, double, double, unsigned, int>(),
+			py::arg("x"), py::arg("g"), py::arg("h"),
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0,
+			py::arg("max_bins") = MAX_BINS,
+			py::arg("top_rate") = 1.0, py::arg("other_rate") = 0.0, py::arg("seed") = 0,
+			py::arg("n_threads") = 1)
+		.def(py::init<const Dataset<X>&, size_t, size_t, double, double, double, double, double, double, size_t, double, double, unsigned, int>(),
+			py::arg("data"),
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0,
+			py::arg("max_bins") = MAX_BINS,
+			py::arg("top_rate") = 1.0, py::arg("other_rate") = 0.0, py::arg("seed") = 0,
+			py::arg("n_threads") = 1)
+		.def("update", &GHHistLayerWiseTreeBuilder<X>::update)
+		.def("get_stats", [](const GHHistLayerWiseTreeBuilder<X>& builder) { return stats_to_dict(builder.get_stats()); })
+		;
+
+	py::class_<GBMTrainer<X>>(m, (std::string("GBMTrainer") + suffix).c_str())
+		.def(py::init<const DMatrix<X>&, const DColumn<>&, const std::string&, size_t, double, double, size_t, size_t, size_t, double, double, double, double, double, double, const std::string&, size_t, int>(),
+			py::arg("x"), py::arg("y"), py::arg("loss") = "mse",
+			py::arg("n_estimators") = 100, py::arg("learning_rate") = 0.1, py::arg("max_delta_step") = INFINITY,
+			py::arg("max_depth") = 6,
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0,
+			py::arg("tree_method") = "exact", py::arg("max_bins") = MAX_BINS,
+			py::arg("n_threads") = 1)
+		// the loop runs without the gil, which is taken back only to call the python callback
+		.def("train", &GBMTrainer<X>::train, py::arg("callback") = nullptr, py::arg("callback_every") = 1,
+			py::return_value_policy::reference_internal, py::call_guard<py::gil_scoped_release>())
+		.def("get_ensemble", &GBMTrainer<X>::get_ensemble, py::return_value_policy::reference_internal)
+		.def("get_predictions", &GBMTrainer<X>::get_predictions)
+		.def("get_iteration", &GBMTrainer<X>::get_iteration)
+		.def("get_loss", &GBMTrainer<X>::get_loss)
+		;
+
+	py::class_<ForestTrainer<X>>(m, (std::string("ForestTrainer") + suffix).c_str())
+		.def(py::init<const DMatrix<X>&, const DColumn<>&, size_t, double, bool, size_t, size_t, size_t, double, double, double, double, unsigned, int>(),
+			py::arg("x"), py::arg("y"),
+			py::arg("n_estimators") = 100, py::arg("subsample") = 1.0, py::arg("bootstrap") = true,
+			py::arg("max_depth") = 10,
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("seed") = 0, py::arg("n_threads") = 1)
+		.def("train", &ForestTrainer<X>::train, py::return_value_policy::reference_internal, py::call_guard<py::gil_scoped_release>())
+		.def("get_ensemble", &ForestTrainer<X>::get_ensemble, py::return_value_policy::reference_internal)
+		.def("get_tree", &ForestTrainer<X>::get_tree, py::return_value_policy::reference_internal)
+		.def("size", &ForestTrainer<X>::size)
+		;
+}
+
 PYBIND11_MODULE(_core, m) {
 	m.doc() = "A python module";
 
-	py::class_<DMatrix<>>(m, "DMatrix");
-	m.def("numpyToDMatrix", &numpyToDMatrix, "...");
+	// double first: arrays of any other dtype than float32 keep being converted to it
+	export_precision<double>(m, "");
+	export_precision<float>(m, "F32");
+	m.def("dataset_feature_size", &datasets::feature_size, "...", py::arg("path"));
 
 	py::class_<DColumn<>>(m, "DColumn");
 	m.def("numpyToDColumn", &numpyToDColumn, "...");
 	m.def("DColumntoNumpyInplace", &DColumntoNumpyInplace, "...");
 
+	py::class_<CSCMatrix<>>(m, "CSCMatrix")
+		.def("nrows", &CSCMatrix<>::nrows)
+		.def("ncols", &CSCMatrix<>::ncols)
+		.def("nnz", &CSCMatrix<>::nnz)
+		;
+	m.def("numpyToCSCMatrix", &numpyToCSCMatrix, "...", py::arg("indptr"), py::arg("indices"), py::arg("data"), py::arg("nrows"), py::arg("ncols"));
+	py::class_<CSRMatrix<>>(m, "CSRMatrix")
+		.def("nrows", &CSRMatrix<>::nrows)
+		.def("ncols", &CSRMatrix<>::ncols)
+		.def("nnz", &CSRMatrix<>::nnz)
+		;
+	m.def("numpyToCSRMatrix", &numpyToCSRMatrix, "...", py::arg("indptr"), py::arg("indices"), py::arg("data"), py::arg("nrows"), py::arg("ncols"));
+
+	py::class_<Loss>(m, "Loss")
+		.def("value", &Loss::value, py::arg("y"), py::arg("p"))
+		.def("grad", &Loss::grad, py::arg("y"), py::arg("p"), py::arg("g"), py::arg("scale") = 1.0, py::arg("n_threads") = 1)
+		.def("grad_and_hess", &Loss::grad_and_hess, py::arg("y"), py::arg("p"), py::arg("g"), py::arg("h"),
+			py::arg("scale") = 1.0, py::arg("n_threads") = 1)
+		.def("base_score", &Loss::base_score, py::arg("y"))
+		;
+	py::class_<MSELoss, Loss>(m, "MSELoss")
+		.def(py::init<>())
+		;
+	py::class_<LogLoss, Loss>(m, "LogLoss")
+		.def(py::init<>())
+		;
+	m.def("get_loss", &losses::get, "...", py::arg("name"));
+
 	// standard decision tree & builders
 	py::class_<TreeNode>(m, "TreeNode")
 		.def_readwrite("is_leaf", &TreeNode::is_leaf)
 		.def_readwrite("value", &TreeNode::value)
 		.def_readwrite("column", &TreeNode::column)
 		.def_readwrite("threshold", &TreeNode::threshold)
+		.def_readwrite("default_left", &TreeNode::default_left)
 		.def_readwrite("criterion", &TreeNode::criterion)
 		.def_readwrite("gain", &TreeNode::gain)
 		.def_readwrite("n", &TreeNode::n)
@@ -35,23 +311,48 @@ PYBIND11_MODULE(_core, m) {
 
 	py::class_<Tree>(m, "Tree")
 		.def(py::init<size_t>(), py::arg("max_depth")=10)
-		.def("predict_value", &Tree::predict_value)
-		.def("predict_leaf", py::overload_cast<const DMatrix<double>&, size_t>(&Tree::predict_leaf, py::const_))
+		.def("predict_value", &Tree::predict_value<double>)
+		.def("predict_value", &Tree::predict_value<float>)
+		.def("predict_value", py::overload_cast<const CSRMatrix<>&>(&Tree::predict_value, py::const_))
+		.def("predict_value", py::overload_cast<const CSCMatrix<>&>(&Tree::predict_value, py::const_))
+		.def("predict_leaf", py::overload_cast<const DMatrix<double>&, size_t>(&Tree::predict_leaf<double>, py::const_))
+		.def("predict_leaf", py::overload_cast<const DMatrix<float>&, size_t>(&Tree::predict_leaf<float>, py::const_))
 		.def("get_node", &Tree::get_node)
+		.def("save", &models::save<Tree>, py::arg("path"))
+		.def_static("load", &models::load_tree, py::arg("path"))
+		.def(py::pickle(
+			[](const Tree& tree) { return py::bytes(models::to_bytes(tree)); },
+			[](const py::bytes& state) { return models::tree_from_bytes(state); }
+			))
 		;
 
-	py::class_<LayerWiseTreeBuilder>(m, "LayerWiseTreeBuilder")
-		.def(py::init<const DMatrix<>&, const DColumn<>&, size_t, size_t, double, double, double, double, double>(),
-			py::arg("x"), py::arg("y"),
-			py::arg("min_samples_leaf") = 1,
-			py::arg("min_samples_split") = 2,
-			py::arg("min_weight_leaf") = 0.0,
-			py::arg("min_weight_split") = 0.0,
-			py::arg("colsample_bytree") = 1.0, 
-			py::arg("colsample_bylevel") = 1.0,
-			py::arg("reg_alpha") = 0.0
-			)
-		.def("update", &LayerWiseTreeBuilder::update)
+	py::class_<CompiledTree>(m, "CompiledTree")
+		.def(py::init<const Tree&>(), py::arg("tree"))
+		.def("predict_value", &CompiledTree::predict_value<double>)
+		.def("predict_value", &CompiledTree::predict_value<float>)
+		.def("predict_leaf", &CompiledTree::predict_leaf<double>)
+		.def("predict_leaf", &CompiledTree::predict_leaf<float>)
+		.def("size", &CompiledTree::size)
+		.def("memory_usage", &CompiledTree::memory_usage)
+		;
+
+	py::class_<Ensemble>(m, "Ensemble")
+		.def(py::init<double, double>(), py::arg("base_score") = 0.0, py::arg("max_delta_step") = INFINITY)
+		.def("add", py::overload_cast<const Tree&>(&Ensemble::add))
+		.def("add", py::overload_cast<const CompiledTree&>(&Ensemble::add))
+		.def("size", &Ensemble::size)
+		.def("memory_usage", &Ensemble::memory_usage)
+		.def("predict", &Ensemble::predict<double>, py::arg("x"), py::arg("n_threads") = 1)
+		.def("predict", &Ensemble::predict<float>, py::arg("x"), py::arg("n_threads") = 1)
+		.def("predict_inplace", &Ensemble::predict_inplace<double>, py::arg("x"), py::arg("out"), py::arg("n_threads") = 1)
+		.def("predict_inplace", &Ensemble::predict_inplace<float>, py::arg("x"), py::arg("out"), py::arg("n_threads") = 1)
+		// a loaded ensemble scores straight from the mapped file
+		.def("save", &models::save<Ensemble>, py::arg("path"))
+		.def_static("load", &models::load_ensemble, py::arg("path"))
+		.def(py::pickle(
+			[](const Ensemble& ensemble) { return py::bytes(models::to_bytes(ensemble)); },
+			[](const py::bytes& state) { return models::ensemble_from_bytes(state); }
+			))
 		;
 
 	py::class_<BaseTreeBuilder>(m, "BaseTreeBuilder")
@@ -59,14 +360,61 @@ PYBIND11_MODULE(_core, m) {
 		.def("update", &BaseTreeBuilder::update)
 		;
 
-	py::class_<GHLayerWiseTreeBuilder>(m, "GHLayerWiseTreeBuilder")
-		.def(py::init<const DMatrix<>&, const DColumn<>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, double>(),
-			py::arg("x"), py::arg("g"), py::arg("h"), 
-			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2, 
+	// paged (out-of-core) data: the builder and the trainer keep a reference to the dataset
+	py::class_<PagedDataset>(m, "PagedDataset")
+		.def(py::init<const std::string&>(), py::arg("path"))
+		.def("nrows", &PagedDataset::nrows)
+		.def("ncols", &PagedDataset::ncols)
+		.def("get_n_pages", &PagedDataset::get_n_pages)
+		.def("get_page_rows", &PagedDataset::get_page_rows)
+		.def("get_max_bins", &PagedDataset::get_max_bins)
+		;
+	py::class_<GHPagedLayerWiseTreeBuilder>(m, "GHPagedLayerWiseTreeBuilder")
+		.def(py::init<const PagedDataset&, const DColumn<>&, const DColumn<>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, double, unsigned, size_t, int>(),
+			py::arg("data"), py::arg("g"), py::arg("h"), py::arg("w"),
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0, py::arg("seed") = 0,
+			py::arg("n_buffers") = 2, py::arg("n_threads") = 1, py::keep_alive<1, 2>())
+		.def("update", &GHPagedLayerWiseTreeBuilder::update)
+		.def("get_stats", [](const GHPagedLayerWiseTreeBuilder& builder) { return stats_to_dict(builder.get_stats()); })
+		;
+	py::class_<PagedGBMTrainer>(m, "PagedGBMTrainer")
+		.def(py::init<const PagedDataset&, const DColumn<>&, const std::string&, size_t, double, double, size_t, size_t, size_t, double, double, double, double, double, double, size_t, int>(),
+			py::arg("data"), py::arg("y"), py::arg("loss") = "mse",
+			py::arg("n_estimators") = 100, py::arg("learning_rate") = 0.1, py::arg("max_delta_step") = INFINITY,
+			py::arg("max_depth") = 6,
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0,
+			py::arg("n_buffers") = 2, py::arg("n_threads") = 1)
+		.def("train", &PagedGBMTrainer::train, py::arg("callback") = nullptr, py::arg("callback_every") = 1,
+			py::return_value_policy::reference_internal, py::call_guard<py::gil_scoped_release>())
+		.def("get_ensemble", &PagedGBMTrainer::get_ensemble, py::return_value_policy::reference_internal)
+		.def("get_predictions", &PagedGBMTrainer::get_predictions)
+		.def("get_iteration", &PagedGBMTrainer::get_iteration)
+		.def("get_loss", &PagedGBMTrainer::get_loss)
+		;
+
+	// sparse builder
+	py::class_<GHSparseLayerWiseTreeBuilder>(m, "GHSparseLayerWiseTreeBuilder")
+		.def(py::init<const CSCMatrix<>&, const DColumn<>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, double, unsigned, int>(),
+			py::arg("x"), py::arg("g"), py::arg("h"),
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
+			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
+			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0, py::arg("seed") = 0,
+			py::arg("n_threads") = 1)
+		.def(py::init<const CSCMatrix<>&, const DColumn<>&, const DColumn<>&, const DColumn<>&, size_t, size_t, double, double, double, double, double, double, unsigned, int>(),
+			py::arg("x"), py::arg("g"), py::arg("h"), py::arg("w"),
+			py::arg("min_samples_leaf") = 1, py::arg("min_samples_split") = 2,
 			py::arg("min_weight_leaf") = 0.0, py::arg("min_weight_split") = 0.0,
 			py::arg("colsample_bytree") = 1.0, py::arg("colsample_bylevel") = 1.0,
-			py::arg("reg_lambda")=1.0, py::arg("reg_alpha")=0.0)
-		.def("update", &GHLayerWiseTreeBuilder::update)
+			py::arg("reg_lambda") = 1.0, py::arg("reg_alpha") = 0.0, py::arg("seed") = 0,
+			py::arg("n_threads") = 1)
+		.def("update", &GHSparseLayerWiseTreeBuilder::update)
 		;
 
 }
@@ -0,0 +1,271 @@
+// end-to-end training scaling study: how the time and the peak memory of one tree grow with the rows,
+// the columns, the depth, colsample_bylevel and the threads, for the main dense builders
+//
+//   scaling [--rows 10000,100000,1000000] [--cols 16] [--depths 8] [--colsample 1.0]
+//           [--threads 1,2,4] [--builders gh,layerwise,split,paged] [--repeats 3] [--seed 42] [--json out.json]
+//
+// every configuration runs in a fresh process (this binary again, with --run) so its peak RSS is its own;
+// a configuration that fails (e.g. out of memory) is reported and the sweep goes on
+// timed: building the tree from the raw matrix, sorting included; not timed: generating the data
+// paged (not in the default sweep) writes the data to a paged file first, untimed, and builds from it
+// prints the throughput (rows * features / s), memory and scaling-efficiency tables
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#define popen _popen
+#define pclose _pclose
+#else
+#include <sys/resource.h>
+#endif
+
+#include <uboost2/data.h>
+#include <uboost2/parallel.h>
+#include <uboost2/tree/tree.h>
+#include <uboost2/tree/builder/builder_layerwise.h>
+#include <uboost2/tree/builder/builder_layerwise_gh.h>
+#include <uboost2/tree/builder/builder_nodewise.h>
+#include <uboost2/tree/builder/builder_layerwise_paged_gh.h>
+
+namespace scaling {
+
+	struct Config {
+		std::vector<size_t> rows = { 10000, 100000, 1000000 };
+		std::vector<size_t> cols = { 16 };
+		std::vector<size_t> depths = { 8 };
+		std::vector<double> colsample = { 1.0 };
+		std::vector<int> threads;
+		std::vector<std::string> builders = { "gh", "layerwise", "split" };
+		size_t repeats = 3;
+		unsigned seed = 42;
+		std::string json;
+	};
+
+	struct Run {
+		std::string builder;
+		size_t rows, cols, depth;
+		double colsample;
+		int threads;
+		bool ok = false;
+		double seconds = 0.0;
+		// peak RSS once the data is generated, and at the end of the training
+		size_t data_bytes = 0, peak_bytes = 0;
+		size_t leaves = 0;
+	};
+
+	template <typename T>
+	std::vector<T> parse_list(const char* arg) {
+		std::vector<T> out;
+		std::stringstream ss(arg);
+		std::string item;
+		while (std::getline(ss, item, ',')) {
+			std::stringstream value(item);
+			T t;
+			value >> t;
+			out.push_back(t);
+		}
+		return out;
+	}
+
+	// high-water mark of the resident memory of this process, in bytes
+	size_t peak_rss() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+#else
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		return (size_t)usage.ru_maxrss;
+#else
+		return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+	}
+
+	// child side: one configuration, the best of the repeats; prints "seconds data_bytes peak_bytes leaves"
+	int run_one(const std::string& builder, size_t nrows, size_t ncols, size_t depth, double colsample, int n_threads,
+		size_t repeats, unsigned seed) {
+		const DMatrix<> x = randoms::uniform(nrows, ncols, seed);
+		DColumn<> y = randoms::normal(nrows, seed + 1);
+		for (size_t i = 0; i < nrows; i++) {
+			const double a = x(i, 0), b = x(i, 1 % ncols), c = x(i, 2 % ncols);
+			y(i) = std::sin(6.0 * a) + a * b + (c > 0.5 ? 1.0 : 0.0) + 0.5 * y(i);
+		}
+		const DColumn<> h(nrows, 1.0);
+		std::string pages;
+		if (builder == "paged") {
+			pages = "scaling-" + std::to_string(nrows) + "x" + std::to_string(ncols) + "-" + std::to_string(seed) + ".pages";
+			paging::save(x, pages, MAX_BINS, paging::PAGE_ROWS, n_threads);
+		}
+		const size_t data_bytes = peak_rss();
+
+		double best = INFINITY;
+		size_t leaves = 0;
+		for (size_t r = 0; r < repeats; r++) {
+			Tree tree(depth);
+			const auto t0 = std::chrono::steady_clock::now();
+			if (builder == "gh") {
+				GHLayerWiseTreeBuilder<>(x, y, h, 1, 2, 0.0, 0.0, 1.0, colsample, 1.0, 0.0, 1.0, 0.0, 0, n_threads).update(tree);
+			}
+			else if (builder == "layerwise") {
+				LayerWiseTreeBuilder<>(x, y, 1, 2, 0.0, 0.0, 1.0, colsample, 0.0, 0, n_threads).update(tree);
+			}
+			else if (builder == "split") {
+				SplitTreeBuilder(x, y, 1, 2, 1.0, colsample).update(tree);
+			}
+			else if (builder == "paged") {
+				const PagedDataset data(pages);
+				GHPagedLayerWiseTreeBuilder(data, y, h, h, 1, 2, 0.0, 0.0, 1.0, colsample, 1.0, 0.0, 0, 2, n_threads).update(tree);
+			}
+			else {
+				std::fprintf(stderr, "unknown builder %s\n", builder.c_str());
+				return 1;
+			}
+			const auto t1 = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+			leaves = tree.get_n_leaves();
+		}
+		if (!pages.empty()) std::remove(pages.c_str());
+		std::printf("%.9g %zu %zu %zu\n", best, data_bytes, peak_rss(), leaves);
+		return 0;
+	}
+
+	// parent side: the same binary with --run, its one line of output parsed back
+	Run spawn(const std::string& self, const Config& cfg, const std::string& builder, size_t nrows, size_t ncols,
+		size_t depth, double colsample, int n_threads) {
+		Run run{ builder, nrows, ncols, depth, colsample, n_threads };
+		std::ostringstream cmd;
+		cmd << "\"" << self << "\" --run " << builder << " " << nrows << " " << ncols << " " << depth << " " << colsample
+			<< " " << n_threads << " " << cfg.repeats << " " << cfg.seed;
+		FILE* pipe = popen(cmd.str().c_str(), "r");
+		if (pipe == nullptr) return run;
+		char line[256] = {};
+		const bool read = std::fgets(line, sizeof(line), pipe) != nullptr;
+		const int status = pclose(pipe);
+		if (read && status == 0) {
+			run.ok = std::sscanf(line, "%lf %zu %zu %zu", &run.seconds, &run.data_bytes, &run.peak_bytes, &run.leaves) == 4;
+		}
+		return run;
+	}
+
+	// output
+
+	double throughput(const Run& r) {
+		return r.rows * r.cols / r.seconds;
+	}
+	double mib(size_t bytes) {
+		return bytes / (1024.0 * 1024.0);
+	}
+
+	void print_tables(const std::vector<Run>& runs) {
+		std::printf("\n## throughput and memory\n\n");
+		std::printf("%-10s %10s %5s %5s %6s %7s %10s %14s %10s %10s %10s\n", "builder", "rows", "cols", "depth", "bylvl",
+			"threads", "seconds", "rows*feat/s", "data MiB", "peak MiB", "train MiB");
+		for (const Run& r : runs) {
+			if (!r.ok) {
+				std::printf("%-10s %10zu %5zu %5zu %6.2f %7d %10s\n", r.builder.c_str(), r.rows, r.cols, r.depth, r.colsample,
+					r.threads, "failed");
+				continue;
+			}
+			std::printf("%-10s %10zu %5zu %5zu %6.2f %7d %10.4f %14.4g %10.1f %10.1f %10.1f\n", r.builder.c_str(), r.rows, r.cols,
+				r.depth, r.colsample, r.threads, r.seconds, throughput(r), mib(r.data_bytes), mib(r.peak_bytes),
+				mib(r.peak_bytes - std::min(r.peak_bytes, r.data_bytes)));
+		}
+
+		// thread scaling of every configuration measured with one thread: speedup t1 / tn, efficiency speedup / n
+		std::map<std::tuple<std::string, size_t, size_t, size_t, double>, double> single;
+		for (const Run& r : runs) {
+			if (r.ok && r.threads == 1) single[{ r.builder, r.rows, r.cols, r.depth, r.colsample }] = r.seconds;
+		}
+		std::printf("\n## thread scaling\n\n");
+		std::printf("%-10s %10s %5s %5s %6s %7s %9s %10s\n", "builder", "rows", "cols", "depth", "bylvl", "threads", "speedup",
+			"efficiency");
+		for (const Run& r : runs) {
+			auto it = single.find({ r.builder, r.rows, r.cols, r.depth, r.colsample });
+			if (!r.ok || it == single.end()) continue;
+			const double speedup = it->second / r.seconds;
+			std::printf("%-10s %10zu %5zu %5zu %6.2f %7d %9.2f %9.0f%%\n", r.builder.c_str(), r.rows, r.cols, r.depth, r.colsample,
+				r.threads, speedup, 100.0 * speedup / r.threads);
+		}
+	}
+
+	void write_json(const std::string& path, const Config& cfg, const std::vector<Run>& runs) {
+		std::ofstream out(path);
+		out.precision(9);
+		out << "{\n  \"benchmark\": \"uboost2-scaling\",\n  \"schema\": 1,\n  \"max_threads\": " << parallel::max_threads()
+			<< ",\n  \"seed\": " << cfg.seed << ",\n  \"repeats\": " << cfg.repeats << ",\n  \"results\": [";
+		for (size_t k = 0; k < runs.size(); k++) {
+			const Run& r = runs[k];
+			out << (k ? ",\n" : "\n") << "    {\"builder\": \"" << r.builder << "\", \"rows\": " << r.rows << ", \"cols\": " << r.cols
+				<< ", \"depth\": " << r.depth << ", \"colsample_bylevel\": " << r.colsample << ", \"threads\": " << r.threads
+				<< ", \"ok\": " << (r.ok ? "true" : "false");
+			if (r.ok) {
+				out << ", \"seconds\": " << r.seconds << ", \"cells_per_s\": " << throughput(r) << ", \"data_bytes\": " << r.data_bytes
+					<< ", \"peak_bytes\": " << r.peak_bytes << ", \"leaves\": " << r.leaves;
+			}
+			out << "}";
+		}
+		out << "\n  ]\n}\n";
+	}
+}
+
+int main(int argc, char** argv) {
+	using namespace scaling;
+	if (argc == 10 && std::string(argv[1]) == "--run") {
+		return run_one(argv[2], std::stoul(argv[3]), std::stoul(argv[4]), std::stoul(argv[5]), std::stod(argv[6]),
+			std::stoi(argv[7]), std::stoul(argv[8]), (unsigned)std::stoul(argv[9]));
+	}
+	Config cfg;
+	for (int a = 1; a < argc; a++) {
+		const std::string arg = argv[a];
+		const char* value = a + 1 < argc ? argv[a + 1] : "";
+		if (arg == "--rows") cfg.rows = parse_list<size_t>(value), a++;
+		else if (arg == "--cols") cfg.cols = parse_list<size_t>(value), a++;
+		else if (arg == "--depths") cfg.depths = parse_list<size_t>(value), a++;
+		else if (arg == "--colsample") cfg.colsample = parse_list<double>(value), a++;
+		else if (arg == "--threads") cfg.threads = parse_list<int>(value), a++;
+		else if (arg == "--builders") cfg.builders = parse_list<std::string>(value), a++;
+		else if (arg == "--repeats") cfg.repeats = std::max<size_t>(1, std::stoul(value)), a++;
+		else if (arg == "--seed") cfg.seed = (unsigned)std::stoul(value), a++;
+		else if (arg == "--json") cfg.json = value, a++;
+		else {
+			std::fprintf(stderr, "unknown argument %s\n", arg.c_str());
+			return 1;
+		}
+	}
+	// powers of two up to the cores, and the cores
+	if (cfg.threads.empty()) {
+		for (int t = 1; t < parallel::max_threads(); t *= 2) cfg.threads.push_back(t);
+		cfg.threads.push_back(parallel::max_threads());
+	}
+
+	std::vector<Run> runs;
+	for (const std::string& builder : cfg.builders)
+	for (size_t nrows : cfg.rows) for (size_t ncols : cfg.cols) for (size_t depth : cfg.depths)
+	for (double colsample : cfg.colsample) for (int n_threads : cfg.threads) {
+		// SplitTreeBuilder is sequential
+		if (builder == "split" && n_threads != 1) continue;
+		std::fprintf(stderr, "%s rows %zu cols %zu depth %zu bylevel %g threads %d\n", builder.c_str(), nrows, ncols, depth,
+			colsample, n_threads);
+		runs.push_back(spawn(argv[0], cfg, builder, nrows, ncols, depth, colsample, n_threads));
+	}
+	print_tables(runs);
+	if (!cfg.json.empty()) write_json(cfg.json, cfg, runs);
+	return 0;
+}